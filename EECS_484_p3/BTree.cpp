@@ -1,23 +1,197 @@
 #include "BTree.h"                                      // file-specific header
 #include "DataEntry.h"                                  // for DataEntry
+#include "FrozenIndex.h"                                // for FrozenIndex
+#include "InnerNode.h"                                  // for InnerNode
 #include "LeafNode.h"                                   // for LeafNode
+#include "OutputBuffer.h"                               // for OutputBuffer
+#include "PostingList.h"                                // for PostingList
 #include "TreeNode.h"                                   // for TreeNode
+#include "TreePolicy.h"                                 // for TreeContext
 #include "Utilities.h"                                  // for Key alias
+#include <algorithm>                                    // for is_sorted, min, upper_bound
 #include <cassert>                                      // for assert
+#include <functional>                                   // for function, greater, less
 #include <iostream>                                     // for ostream
+#include <limits>                                       // for numeric_limits
+#include <map>                                          // for map
+#include <mutex>                                        // for lock_guard
+#include <string>                                       // for string, to_string
+#include <thread>                                       // for hardware_concurrency
+#include <utility>                                      // for pair
 #include <vector>                                       // for vector
 
 using std::vector;
 using std::ostream;
+using std::string; using std::to_string;
+using std::numeric_limits;
+using std::map;
+using std::pair;
+using std::function;
+using std::lock_guard; using std::mutex;
+
+static const constexpr size_t kParallelVerifySize = 1 << 16;   // smaller trees verify on one thread
+
+
+// walk the chain of <left> leftward from its last leaf and the chain of
+// <right> rightward from its first, a leaf of each at a time, until one
+// runs out; set <live> and <dead> to what that side holds and return TRUE
+// if it was the right side
+static bool countSmallerSide(const TreeNode* left, const TreeNode* right, size_t& live, size_t& dead) {
+    auto leftLeaf = left->findLeaf(numeric_limits<Key>::max());
+    auto rightLeaf = right->findLeaf(numeric_limits<Key>::min());
+    size_t leftLive = 0, leftDead = 0, rightLive = 0, rightDead = 0;
+    while (leftLeaf && rightLeaf) {
+        size_t deadHere = leftLeaf->deadEntries();
+        leftDead += deadHere;
+        leftLive += leftLeaf->size() - deadHere;
+        leftLeaf = leftLeaf->getLeftNeighbor();
+        
+        deadHere = rightLeaf->deadEntries();
+        rightDead += deadHere;
+        rightLive += rightLeaf->size() - deadHere;
+        rightLeaf = rightLeaf->getRightNeighbor();
+    }
+    
+    bool rightDone = !rightLeaf;
+    live = rightDone ? rightLive : leftLive;
+    dead = rightDone ? rightDead : leftDead;
+    return rightDone;
+}
+
+// merge the combined messages from <message> to <lastMessage> into the
+// stored entries from <entry> to <lastEntry>, both ordered by <precedes>,
+// appending to <results> until it holds <limit>; a plain insert over a
+// stored entry gives way to it
+template <typename MessageIter, typename EntryIter, typename Precedes>
+static void overlay(MessageIter message, MessageIter lastMessage, EntryIter entry, EntryIter lastEntry,
+                    size_t limit, vector<DataEntry>& results, Precedes precedes) {
+    while (results.size() < limit && (message != lastMessage || entry != lastEntry)) {
+        if (entry == lastEntry || (message != lastMessage && !precedes(Key(*entry), message->first))) {
+            bool overlaid = (entry != lastEntry && message->first == Key(*entry));
+            if (!message->second.isDelete) {
+                results.push_back((overlaid && !message->second.replaces) ? *entry : message->second.entry);
+            }
+            entry += overlaid ? 1 : 0;
+            ++message;
+        }
+        else {
+            results.push_back(*entry++);
+        }
+    }
+}
+
+// lowest set bit of <i>, the span of a Fenwick tree slot
+static size_t lowestBit(size_t i) {
+    return i & (~i + 1);
+}
+
+// the slots of <tree> covering leaf <leaf> and everything after it
+static void addRank(vector<size_t>& tree, size_t leaf, bool added) {
+    for (size_t i = leaf + 1; i < tree.size(); i += lowestBit(i)) {
+        tree[i] = added ? tree[i] + 1 : tree[i] - 1;
+    }
+}
+
+// live entries in the leaves in front of leaf <leaf>
+static size_t ranksBefore(const vector<size_t>& tree, size_t leaf) {
+    size_t before = 0;
+    for (size_t i = leaf; i > 0; i -= lowestBit(i)) {
+        before += tree[i];
+    }
+    return before;
+}
+
+// descend by halving spans to the leaf holding live entry <target>, leaving
+// in <target> how many live entries of that leaf precede it
+static size_t findRank(const vector<size_t>& tree, size_t& target) {
+    size_t span = 1;
+    while (span * 2 < tree.size()) {
+        span *= 2;
+    }
+    size_t leaf = 0;
+    for (; span > 0; span /= 2) {
+        if (leaf + span < tree.size() && tree[leaf + span] <= target) {
+            leaf += span;
+            target -= tree[leaf];
+        }
+    }
+    return leaf;
+}
+
+// a threshold policy holding the lower of each minimum of the two; it may
+// allow inner nodes no keys at all, which no policy a tree runs under can
+static TreePolicy lowerFloor(const TreePolicy& lhs, const TreePolicy& rhs) {
+    TreePolicy lowered{};
+    lowered.rebalance = Rebalance::Threshold;
+    lowered.leafThreshold = std::min(lhs.leafMinimum(), rhs.leafMinimum());
+    lowered.innerThreshold = std::min(lhs.innerMinimum(), rhs.innerMinimum());
+    return lowered;
+}
+
+// leaves first, then one inner level at a time until a single root is left
+static TreeNode* buildTree(const vector<DataEntry>& sorted, const TreePolicy& policy) {
+    auto level = LeafNode::buildChain(sorted, policy);
+    while (level.size() > 1) {
+        level = InnerNode::buildLevel(level, policy);
+    }
+    return level.front();
+}
 
 
 // constructor; root begins as empty leaf node
 BTree::BTree()
-    : root{ new LeafNode{} }, height{ 0 }, size{ 0 } {}
+    : root{ new LeafNode{} }, height{ 0 }, size{ 0 }, tombstones{ 0 }, lazyDelete{ false },
+      buffered{ false }, multiValue{ false }, frozen{ nullptr }, finger{ nullptr }, postingLists{},
+      freeLists{}, postings{ 0 }, pendingLive{ 0 }, stamp{ 0 }, rankLock{}, rankIndex{}, rankCounts{}, rankTotal{ 0 },
+      rankStamp{ numeric_limits<size_t>::max() }, policy{}, floor{}, stats{} {}
 
 // destructor
 BTree::~BTree() {
-    //delete root;
+    delete root;
+    delete frozen;
+}
+
+// move constructor; start empty, then trade places
+BTree::BTree(BTree&& other)
+    : BTree{} {
+
+    swap(other);
+}
+
+// move assignment; the old contents end up in a temporary that frees them
+BTree& BTree::operator=(BTree&& rhs) {
+    if (this != &rhs) {
+        BTree emptied{};
+        swap(rhs);
+        rhs.swap(emptied);
+    }
+    return *this;
+}
+
+// member by member
+void BTree::swap(BTree& other) {
+    using std::swap;
+    swap(root, other.root);
+    swap(height, other.height);
+    swap(size, other.size);
+    swap(tombstones, other.tombstones);
+    swap(lazyDelete, other.lazyDelete);
+    swap(buffered, other.buffered);
+    swap(multiValue, other.multiValue);
+    swap(frozen, other.frozen);
+    swap(finger, other.finger);
+    swap(postingLists, other.postingLists);
+    swap(freeLists, other.freeLists);
+    swap(postings, other.postings);
+    swap(pendingLive, other.pendingLive);
+    swap(stamp, other.stamp);
+    swap(rankIndex, other.rankIndex);
+    swap(rankCounts, other.rankCounts);
+    swap(rankTotal, other.rankTotal);
+    swap(rankStamp, other.rankStamp);
+    swap(policy, other.policy);
+    swap(floor, other.floor);
+    swap(stats, other.stats);
 }
 
 // return height
@@ -27,47 +201,991 @@ size_t BTree::getHeight() const {
 
 // return number of entries
 size_t BTree::getSize() const {
-    return size;
+    long live = static_cast<long>(size) + pendingLive;
+    return (live > 0) ? static_cast<size_t>(live) : 0;
+}
+
+// return policy
+const TreePolicy& BTree::getPolicy() const {
+    return policy;
+}
+
+// replace policy; applies from the next operation on, while nodes built
+// under a looser one may stay as they are
+void BTree::setPolicy(const TreePolicy& newPolicy) {
+    assert(newPolicy.rebalance != Rebalance::Threshold
+           || (newPolicy.leafThreshold >= 1 && newPolicy.leafThreshold <= kLeafOrder
+               && newPolicy.innerThreshold >= 1 && newPolicy.innerThreshold <= kInnerOrder));
+    
+    policy = newPolicy;
+    floor = lowerFloor(floor, policy);
+}
+
+// return restructure counters
+const RestructureStats& BTree::getStats() const {
+    return stats;
+}
+
+// return number of dead entries
+size_t BTree::getTombstones() const {
+    return tombstones;
+}
+
+// return number of posted records
+size_t BTree::getPostings() const {
+    return postings;
+}
+
+// ask the root, which applies buffered messages on the way down
+bool BTree::contains(const Key& key) const {
+    if (frozen) {
+        return frozen->find(key) != nullptr;
+    }
+    return root->contains(key);
 }
 
 void BTree::insertEntry(const DataEntry& newEntry) {
     // TO DO: implement this function
-    TreeNode *node;
-    if(!this->root->contains(Key(newEntry))){
-        node = this->root->insertIntoRoot(newEntry);
-        if(this->root != node){
-            this->root = node;
-            this->height++;
-        }
-        
+    assert(!frozen);
+    stamp++;
+    
+    if(multiValue){
+        insertPosting(Key(newEntry), *newEntry.getRecord());
+        return;
+    }
+    
+    //buffered mode sends the message without looking; the leaf it reaches
+    //decides whether it adds anything
+    if(buffered){
+        sendMessage(BufferedMessage{ newEntry, false });
+        return;
+    }
+    
+    //a dead entry with this key is brought back in place
+    auto leaf = fingerSearch(newEntry);
+    if(leaf->reviveEntry(newEntry)){
+        this->tombstones--;
         this->size++;
-    }    
+        adjustRanks(newEntry, 1, leafRestructures());
+        return;
+    }
+    
+    if(!leaf->contains(Key(newEntry))){
+        placeEntry(leaf, newEntry);
+    }
+    else{
+        adjustRanks(newEntry, 0, leafRestructures());
+    }
+}
+
+// the counters live on <this>, so hand them out by reference
+TreeContext BTree::context() {
+    return TreeContext{ policy, stats };
+}
+
+// a split narrows the fence of the leaf, which keeps it current, so the
+// finger stays; it may also have added a new root, which the old root
+// then has as its parent, so looking costs nothing otherwise
+void BTree::placeEntry(LeafNode* leaf, const DataEntry& newEntry) {
+    size_t leafChanges = leafRestructures();
+    leaf->insertEntry(newEntry, context());
+    
+    auto node = root->findRoot();
+    if (root != node) {
+        root = node;
+        height++;
+    }
+    size++;
+    adjustRanks(newEntry, 1, leafChanges);
+}
+
+// reuse the last leaf while keys stay inside its fence
+LeafNode* BTree::fingerSearch(const Key& key) {
+    if (finger && finger->getFence().contains(key)) {
+        return finger;
+    }
+    finger = root->findLeaf(key);
+    return finger;
 }
 
 void BTree::deleteEntry(const DataEntry& entryToRemove) {
     // TO DO: implement this function
+    assert(!frozen);
+    stamp++;
     Key toRemove = Key(entryToRemove);
     
+    if(buffered){
+        sendMessage(BufferedMessage{ entryToRemove, true });
+        return;
+    }
+    
+    if(lazyDelete){
+        bool marked = fingerSearch(toRemove)->markDead(toRemove);
+        if(marked){
+            this->tombstones++;
+            this->size--;
+        }
+        adjustRanks(toRemove, marked ? -1 : 0, leafRestructures());
+        return;
+    }
+    
+    size_t leafChanges = leafRestructures();
     if(root->contains(toRemove)){
-        auto updated = root->deleteFromRoot(entryToRemove);
+        finger = nullptr;
+        if(multiValue){
+            releaseList((*root)[toRemove]);
+        }
+        auto updated = root->deleteFromRoot(entryToRemove, context());
         
         if(this->root != updated){
-            this->height--;
             this->root = updated;
+            this->height = updated->height();
         }
         
         this->size--;
+        adjustRanks(toRemove, -1, leafChanges);
+        return;
     }
+    adjustRanks(toRemove, 0, leafChanges);
+}
+
+// an upsert is an update that ignores the old record
+Upsert BTree::upsert(const Key& key, const Record& record) {
+    return update(key, [&record](const Record&) { return record; });
 }
 
+// one descent to the leaf, or to the buffer whose message settles the key
+Upsert BTree::update(const Key& key, const function<Record(const Record&)>& modify) {
+    assert(!multiValue);
+    assert(!frozen);
+    stamp++;
+    
+    LeafNode* leaf = buffered ? nullptr : fingerSearch(key);
+    auto entry = leaf ? leaf->findEntry(key) : root->findEntry(key);
+    if (entry) {
+        entry->setRecord(modify(*entry->getRecord()));
+        if (!buffered) {
+            adjustRanks(key, 0, leafRestructures());
+        }
+        return Upsert::Updated;
+    }
+    
+    DataEntry created{ key, key };
+    created.setRecord(modify(Record{}));
+    if (buffered) {
+        sendMessage(BufferedMessage{ created, false });
+    }
+    else if (leaf->reviveEntry(created)) {
+        tombstones--;
+        size++;
+        adjustRanks(key, 1, leafRestructures());
+    }
+    else {
+        placeEntry(leaf, created);
+    }
+    return Upsert::Inserted;
+}
+
+// switching is only allowed on an empty tree, so no entry needs converting
+void BTree::setMultiValue(bool enabled) {
+    assert(size == 0 && tombstones == 0);
+    assert(!enabled || (!lazyDelete && !buffered));
+    assert(!frozen);
+    stamp++;
+    
+    multiValue = enabled;
+    postingLists.clear();
+    freeLists.clear();
+    postings = 0;
+}
+
+// the first record of a key creates it, naming a fresh list
+bool BTree::insertPosting(const Key& key, const Record& record) {
+    assert(multiValue);
+    assert(!frozen);
+    stamp++;
+    
+    auto leaf = fingerSearch(key);
+    if (leaf->contains(key)) {
+        bool added = postingLists[*(*leaf)[key].getRecord()].insert(record);
+        postings += added;
+        return added;
+    }
+    
+    placeEntry(leaf, DataEntry::forPostings(key, allocateList(record)));
+    postings++;
+    return true;
+}
+
+// the last record of a key takes the key with it
+bool BTree::deletePosting(const Key& key, const Record& record) {
+    assert(multiValue);
+    assert(!frozen);
+    stamp++;
+    
+    auto leaf = fingerSearch(key);
+    if (!leaf->contains(key)) {
+        return false;
+    }
+    DataEntry entry = (*leaf)[key];
+    auto& list = postingLists[*entry.getRecord()];
+    if (list.size() == 1 && list.contains(record)) {
+        deleteEntry(entry);
+        return true;
+    }
+    if (list.erase(record)) {
+        postings--;
+        return true;
+    }
+    return false;
+}
+
+// one lookup, then decode the list
+vector<Record> BTree::findPostings(const Key& key) const {
+    assert(multiValue);
+    
+    vector<Record> records;
+    if (root->contains(key)) {
+        postingLists[*(*root)[key].getRecord()].appendTo(records);
+    }
+    return records;
+}
+
+// find the keys, then expand each into its records
+vector<pair<Key, Record>> BTree::rangePostings(const Key& begin, const Key& end) const {
+    assert(multiValue);
+    
+    vector<pair<Key, Record>> results;
+    vector<Record> records;
+    for (const auto& entry : root->rangeFind(begin, end)) {
+        records.clear();
+        postingLists[*entry.getRecord()].appendTo(records);
+        for (auto record : records) {
+            results.emplace_back(Key(entry), record);
+        }
+    }
+    return results;
+}
+
+// reuse a released slot before growing
+size_t BTree::allocateList(const Record& first) {
+    if (freeLists.empty()) {
+        postingLists.emplace_back(first);
+        return postingLists.size() - 1;
+    }
+    
+    size_t slot = freeLists.back();
+    freeLists.pop_back();
+    postingLists[slot] = PostingList{ first };
+    return slot;
+}
+
+// drop the records now; the slot is only overwritten when reused
+void BTree::releaseList(const DataEntry& entry) {
+    size_t slot = static_cast<size_t>(*entry.getRecord());
+    postings -= postingLists[slot].size();
+    postingLists[slot] = PostingList{ 0 };
+    freeLists.push_back(slot);
+}
+
+// cut out the middle tree, count what its leaves held, then free it whole
+size_t BTree::deleteRange(const Key& begin, const Key& end) {
+    assert(end >= begin);
+    assert(!frozen);
+    stamp++;
+    
+    if (buffered) {
+        flushBuffers();
+    }
+    finger = nullptr;
+    
+    auto lower = InnerNode::split(root, begin, context());
+    TreeNode* doomed = lower.second;
+    TreeNode* upper = nullptr;
+    if (end != numeric_limits<Key>::max()) {
+        auto cut = InnerNode::split(lower.second, end + 1, context());
+        doomed = cut.first;
+        upper = cut.second;
+    }
+    
+    size_t removed = 0;
+    size_t dead = 0;
+    for (auto leaf = doomed->findLeaf(numeric_limits<Key>::min()); leaf; leaf = leaf->getRightNeighbor()) {
+        removed += leaf->size();
+        dead += leaf->deadEntries();
+    }
+    if (multiValue) {
+        for (const auto& entry : doomed->rangeFind(numeric_limits<Key>::min(), numeric_limits<Key>::max())) {
+            releaseList(entry);
+        }
+    }
+    delete doomed;
+    
+    root = InnerNode::join(lower.first, upper, context());
+    height = root->height();
+    size -= removed - dead;
+    tombstones -= dead;
+    return removed - dead;
+}
+
+// cut along the path to <key>, then count whichever side is smaller
+BTree BTree::splitAt(const Key& key) {
+    assert(!multiValue);
+    assert(!frozen);
+    stamp++;
+    
+    if (buffered) {
+        flushBuffers();
+    }
+    finger = nullptr;
+    
+    auto halves = InnerNode::split(root, key, context());
+    size_t live = 0;
+    size_t dead = 0;
+    bool upperCounted = countSmallerSide(halves.first, halves.second, live, dead);
+    size_t upperLive = upperCounted ? live : size - live;
+    size_t upperDead = upperCounted ? dead : tombstones - dead;
+    
+    BTree upper{};
+    delete upper.root;
+    upper.root = halves.second;
+    upper.height = upper.root->height();
+    upper.size = upperLive;
+    upper.tombstones = upperDead;
+    upper.lazyDelete = lazyDelete;
+    upper.buffered = buffered;
+    upper.policy = policy;
+    upper.floor = floor;
+    
+    root = halves.first;
+    height = root->height();
+    size -= upperLive;
+    tombstones -= upperDead;
+    return upper;
+}
+
+// hang the shorter tree off the spine of the taller one
+void BTree::join(BTree&& rhs) {
+    assert(&rhs != this);
+    assert(!multiValue && !rhs.multiValue);
+    assert(!frozen && !rhs.frozen);
+    stamp++;
+    rhs.stamp++;
+    
+    if (buffered) {
+        flushBuffers();
+    }
+    if (rhs.buffered) {
+        rhs.flushBuffers();
+    }
+    assert(size + tombstones == 0 || rhs.size + rhs.tombstones == 0 || root->maxKey() < rhs.root->minKey());
+    finger = nullptr;
+    rhs.finger = nullptr;
+    
+    root = InnerNode::join(root, rhs.root, context());
+    height = root->height();
+    floor = lowerFloor(floor, rhs.floor);
+    size += rhs.size;
+    tombstones += rhs.tombstones;
+    
+    rhs.root = new LeafNode{};
+    rhs.height = 0;
+    rhs.size = 0;
+    rhs.tombstones = 0;
+}
+
+// only the slice of <this> spanned by the keys of <other> is cut out and
+// rebuilt; the rest is split off and joined back along two paths
+void BTree::mergeFrom(const BTree& other) {
+    assert(&other != this);
+    assert(!multiValue && !other.multiValue);
+    assert(!frozen);
+    
+    auto delta = other.rangeFind(numeric_limits<Key>::min(), numeric_limits<Key>::max());
+    if (delta.empty()) {
+        return;
+    }
+    stamp++;
+    if (buffered) {
+        flushBuffers();
+    }
+    finger = nullptr;
+    
+    Key high = delta.back();
+    auto lower = InnerNode::split(root, delta.front(), context());
+    TreeNode* slice = lower.second;
+    TreeNode* upper = nullptr;
+    if (high != numeric_limits<Key>::max()) {
+        auto cut = InnerNode::split(lower.second, high + 1, context());
+        slice = cut.first;
+        upper = cut.second;
+    }
+    
+    //one pass over both in key order; a live key of <this> keeps its
+    //record, while a dead one is replaced as an insert would revive it
+    auto base = slice->findLeaf(numeric_limits<Key>::min())->rangeFind(numeric_limits<Key>::min(),
+                                                                        numeric_limits<Key>::max());
+    size_t dead = 0;
+    for (auto leaf = slice->findLeaf(numeric_limits<Key>::min()); leaf; leaf = leaf->getRightNeighbor()) {
+        dead += leaf->deadEntries();
+    }
+    delete slice;
+    
+    vector<DataEntry> merged;
+    merged.reserve(base.size() + delta.size());
+    auto mine = base.cbegin();
+    auto theirs = delta.cbegin();
+    while (mine != base.cend() || theirs != delta.cend()) {
+        if (theirs == delta.cend() || (mine != base.cend() && *mine <= *theirs)) {
+            if (theirs != delta.cend() && *mine == *theirs) {
+                ++theirs;
+            }
+            merged.push_back(*mine++);
+        }
+        else {
+            merged.push_back(*theirs++);
+        }
+    }
+    
+    root = InnerNode::join(InnerNode::join(lower.first, buildTree(merged, policy), context()), upper, context());
+    height = root->height();
+    size += merged.size() - base.size();
+    tombstones -= dead;
+}
+
+// compacting on the way out leaves no tombstones behind
+void BTree::setLazyDelete(bool enabled) {
+    assert(!enabled || !multiValue);
+    assert(!frozen);
+    stamp++;
+    
+    if (lazyDelete && !enabled) {
+        compact();
+    }
+    lazyDelete = enabled;
+}
+
+// flushing first also keeps buffers out of the way of merges
+void BTree::setBuffered(bool enabled) {
+    assert(!enabled || !multiValue);
+    assert(!frozen);
+    stamp++;
+    
+    if (buffered && !enabled) {
+        flushBuffers();
+        if (!lazyDelete) {
+            compact();
+        }
+    }
+    buffered = enabled;
+}
+
+// the message is settled only where it reaches a leaf, so its guess is
+// counted until then and the counters follow whatever the absorb reports;
+// splits below can reach the root more than once in a single batch
+void BTree::sendMessage(const BufferedMessage& message) {
+    finger = nullptr;
+    EntryDelta delta = root->absorb(vector<BufferedMessage>{ message }, context());
+    size = static_cast<size_t>(static_cast<long>(size) + delta.live);
+    tombstones = static_cast<size_t>(static_cast<long>(tombstones) + delta.dead);
+    pendingLive += message.guess() + delta.guessed;
+    
+    auto newRoot = root->findRoot();
+    if (newRoot != root) {
+        root = newRoot;
+        height = root->height();
+    }
+}
+
+// a root split during the flush leaves the new right half unvisited,
+// so go again from the new root until it stays put
+void BTree::flushBuffers() {
+    finger = nullptr;
+    
+    TreeNode* flushed = nullptr;
+    while (flushed != root) {
+        flushed = root;
+        EntryDelta delta = root->flushAll(context());
+        size = static_cast<size_t>(static_cast<long>(size) + delta.live);
+        tombstones = static_cast<size_t>(static_cast<long>(tombstones) + delta.dead);
+        pendingLive += delta.guessed;
+        root = root->findRoot();
+    }
+    height = root->height();
+    assert(pendingLive == 0);
+}
+
+// purge in place every leaf that stays full enough; separators stay valid,
+// so only the runs of adjacent leaves that would be left underfull are cut
+// out, rebuilt and joined back
+size_t BTree::compact() {
+    assert(!frozen);
+    stamp++;
+    if (buffered) {
+        flushBuffers();
+    }
+    if (tombstones == 0) {
+        return 0;
+    }
+    
+    //a run keeps its tombstones until it is rebuilt, so every seam is cut
+    //through leaves that still meet the minimum; it is bounded by the
+    //purged leaves on either side of it, which are never empty
+    size_t reclaimed = 0;
+    vector<Fence> runs;
+    const LeafNode* kept = nullptr;
+    bool inRun = false;
+    for (auto leaf = root->findLeaf(numeric_limits<Key>::min()); leaf; leaf = leaf->getRightNeighbor()) {
+        if (leaf->underflowsLive(policy)) {
+            if (!inRun) {
+                runs.push_back(Fence{ kept != nullptr, kept ? kept->maxKey() + 1 : 0, false, 0 });
+                inRun = true;
+            }
+            reclaimed += leaf->deadEntries();
+            continue;
+        }
+        reclaimed += leaf->purgeTombstones();
+        if (inRun) {
+            runs.back().hasHigh = true;
+            runs.back().high = leaf->minKey();
+            inRun = false;
+        }
+        kept = leaf;
+    }
+    assert(reclaimed == tombstones);
+    tombstones = 0;
+    
+    finger = nullptr;
+    for (const auto& run : runs) {
+        TreeNode* lower = nullptr;
+        TreeNode* slice = root;
+        TreeNode* upper = nullptr;
+        if (run.hasLow) {
+            auto cut = InnerNode::split(slice, run.low, context());
+            lower = cut.first;
+            slice = cut.second;
+        }
+        if (run.hasHigh) {
+            auto cut = InnerNode::split(slice, run.high, context());
+            slice = cut.first;
+            upper = cut.second;
+        }
+        
+        auto live = slice->findLeaf(numeric_limits<Key>::min())->rangeFind(numeric_limits<Key>::min(),
+                                                                           numeric_limits<Key>::max());
+        delete slice;
+        root = InnerNode::join(InnerNode::join(lower, buildTree(live, policy), context()), upper, context());
+    }
+    height = root->height();
+    return reclaimed;
+}
+
+// a fresh bottom-up build allocates the leaves in chain order
+void BTree::repack() {
+    assert(!frozen);
+    stamp++;
+    if (buffered) {
+        flushBuffers();
+    }
+    
+    rebuild(rangeFind(numeric_limits<Key>::min(), numeric_limits<Key>::max()));
+}
+
+// the nodes go once their live entries are copied out
+void BTree::freeze() {
+    assert(!multiValue);
+    if (frozen) {
+        return;
+    }
+    stamp++;
+    if (buffered) {
+        flushBuffers();
+    }
+    
+    auto live = rangeFind(numeric_limits<Key>::min(), numeric_limits<Key>::max());
+    frozen = new FrozenIndex{ live };
+    delete root;
+    root = new LeafNode{};
+    finger = nullptr;
+    height = 0;
+    size = live.size();
+    tombstones = 0;
+}
+
+// the frozen entries are already sorted, so they are built straight back
+void BTree::thaw() {
+    if (!frozen) {
+        return;
+    }
+    stamp++;
+    
+    rebuild(frozen->getEntries());
+    delete frozen;
+    frozen = nullptr;
+}
+
+// the whole tree goes, so the finger goes with it
+void BTree::rebuild(const vector<DataEntry>& sorted) {
+    delete root;
+    finger = nullptr;
+    root = buildTree(sorted, policy);
+    height = root->height();
+    floor = policy;
+    size = sorted.size();
+    tombstones = 0;
+}
+
+// the whole range is a single page with no limit
 vector<DataEntry> BTree::rangeFind(const Key& begin, const Key& end) const {
     // TO DO: implement this function
-    return root->rangeFind(begin, end);
+    return scan(begin, end, numeric_limits<size_t>::max());
+}
+
+// a page remembers its last key, so the next one starts just past it
+vector<DataEntry> BTree::rangeFind(const Key& begin, const Key& end, size_t limit, PageToken& token) const {
+    assert(end >= begin);
+    assert(limit >= 1);
+    
+    auto page = scan(begin, end, limit);
+    token.lastKey = page.empty() ? end : Key(page.back());
+    token.stamp = stamp;
+    token.exhausted = (page.size() < limit || token.lastKey == end);
+    return page;
+}
+
+// one descent to just past the last key returned
+vector<DataEntry> BTree::resumeRangeFind(const Key& end, size_t limit, PageToken& token) const {
+    assert(!token.exhausted && token.lastKey < end);
+    
+    return rangeFind(token.lastKey + 1, end, limit, token);
+}
+
+// turn the offset into the key it lands on, then page from there
+vector<DataEntry> BTree::rangeFindAt(const Key& begin, const Key& end, size_t offset, size_t limit,
+                                     PageToken& token) const {
+    assert(end >= begin);
+    
+    bool landed = false;
+    Key start = begin;
+    if (frozen) {
+        size_t target = frozen->rank(begin);
+        if (offset < frozen->size() - target) {
+            landed = true;
+            start = frozen->getEntries()[target + offset];
+        }
+    }
+    else if (buffered) {
+        size_t wanted = (offset == numeric_limits<size_t>::max()) ? offset : offset + 1;
+        auto skipped = scan(begin, end, wanted);
+        if (skipped.size() > offset) {
+            landed = true;
+            start = skipped[offset];
+        }
+    }
+    else {
+        lock_guard<mutex> guard{ rankLock };
+        if (rankStamp != stamp) {
+            refreshRanks();
+        }
+        //the last leaf whose fence starts at or before <begin> holds it
+        size_t holder = static_cast<size_t>(std::upper_bound(rankIndex.cbegin(), rankIndex.cend(), begin,
+                                                             [](const Key& k, const LeafRank& rank) { return k < rank.low; })
+                                            - rankIndex.cbegin()) - 1;
+        size_t target = ranksBefore(rankCounts, holder) + rankIndex[holder].leaf->liveBefore(begin);
+        if (offset < rankTotal - target) {
+            target += offset;
+            size_t owner = findRank(rankCounts, target);
+            landed = true;
+            start = rankIndex[owner].leaf->liveKeyAt(target);
+        }
+    }
+    
+    if (!landed || start > end) {
+        token = PageToken{ end, stamp, true };
+        return vector<DataEntry>{};
+    }
+    return rangeFind(start, end, limit, token);
 }
 
-// print tree
+// the stamp moves on every modification
+bool BTree::isCurrent(const PageToken& token) const {
+    return token.stamp == stamp;
+}
+
+// one pass over the leaves for their counts, then each Fenwick slot adds
+// itself to the next slot whose span covers it
+void BTree::refreshRanks() const {
+    rankIndex.clear();
+    rankCounts.assign(1, 0);
+    rankTotal = 0;
+    for (auto leaf = root->findLeaf(numeric_limits<Key>::min()); leaf; leaf = leaf->getRightNeighbor()) {
+        const Fence& fence = leaf->getFence();
+        rankIndex.push_back(LeafRank{ leaf, fence.hasLow ? fence.low : numeric_limits<Key>::min() });
+        rankCounts.push_back(leaf->size() - leaf->deadEntries());
+        rankTotal += rankCounts.back();
+    }
+    for (size_t i = 1; i < rankCounts.size(); ++i) {
+        size_t covering = i + lowestBit(i);
+        if (covering < rankCounts.size()) {
+            rankCounts[covering] += rankCounts[i];
+        }
+    }
+    rankStamp = stamp;
+}
+
+// fences only move when a leaf is restructured, so until then the leaf
+// found for <key> by its low fence is still the one holding it
+void BTree::adjustRanks(const Key& key, long delta, size_t leafChanges) {
+    lock_guard<mutex> guard{ rankLock };
+    if (rankStamp != stamp - 1 || leafChanges != leafRestructures()) {
+        return;
+    }
+    if (delta != 0) {
+        size_t holder = static_cast<size_t>(std::upper_bound(rankIndex.cbegin(), rankIndex.cend(), key,
+                                                             [](const Key& k, const LeafRank& rank) { return k < rank.low; })
+                                            - rankIndex.cbegin()) - 1;
+        addRank(rankCounts, holder, delta > 0);
+        rankTotal = (delta > 0) ? rankTotal + 1 : rankTotal - 1;
+    }
+    rankStamp = stamp;
+}
+
+// borrows count because they move a fence between two leaves
+size_t BTree::leafRestructures() const {
+    return stats.leafSplits + stats.leafBorrows + stats.leafMerges + stats.leafFrees;
+}
+
+// in buffered mode, walk the leaves a window at a time: the keys the
+// fence of one leaf admits, with the combined messages for just those keys
+// overlaid on what the leaf holds, so a page collects only the messages of
+// the leaves it covers
+vector<DataEntry> BTree::scan(const Key& begin, const Key& end, size_t limit) const {
+    assert(end >= begin);
+    
+    if (frozen) {
+        return frozen->rangeFind(begin, end, limit);
+    }
+    auto leaf = root->findLeaf(begin);
+    if (!buffered) {
+        return leaf->rangeFind(begin, end, limit);
+    }
+    
+    vector<DataEntry> results;
+    map<Key, BufferedMessage> pending;
+    vector<DataEntry> stored;
+    Key low = begin;
+    for (; leaf && results.size() < limit; leaf = leaf->getRightNeighbor()) {
+        const Fence& fence = leaf->getFence();
+        bool last = (!fence.hasHigh || fence.high > end);
+        Key high = last ? end : fence.high - 1;
+        
+        pending.clear();
+        stored.clear();
+        root->collectMessages(low, high, pending);
+        leaf->appendLive(low, high, stored);
+        overlay(pending.cbegin(), pending.cend(), stored.cbegin(), stored.cend(), limit, results, std::less<Key>{});
+        if (last) {
+            break;
+        }
+        low = fence.high;
+    }
+    return results;
+}
+
+// the mirror of scan: windows from the leaf holding <end> leftward, each
+// overlaid from its largest key down
+vector<DataEntry> BTree::reverseRangeFind(const Key& begin, const Key& end, size_t limit) const {
+    assert(end >= begin);
+    
+    if (frozen) {
+        return frozen->reverseRangeFind(begin, end, limit);
+    }
+    auto leaf = root->findLeaf(end);
+    if (!buffered) {
+        return leaf->reverseRangeFind(begin, end, limit);
+    }
+    
+    vector<DataEntry> results;
+    map<Key, BufferedMessage> pending;
+    vector<DataEntry> stored;
+    Key high = end;
+    for (; leaf && results.size() < limit; leaf = leaf->getLeftNeighbor()) {
+        const Fence& fence = leaf->getFence();
+        bool last = (!fence.hasLow || fence.low <= begin);
+        Key low = last ? begin : fence.low;
+        
+        pending.clear();
+        stored.clear();
+        root->collectMessages(low, high, pending);
+        leaf->appendLive(low, high, stored);
+        overlay(pending.crbegin(), pending.crend(), stored.crbegin(), stored.crend(), limit, results,
+                std::greater<Key>{});
+        if (last) {
+            break;
+        }
+        high = fence.low - 1;
+    }
+    return results;
+}
+
+// every lookup alternates between prefetching a node and stepping
+// through it, and each of those moves is followed by a turn for every
+// other lookup in the group, which is when the prefetched lines arrive
+void BTree::containsMany(const vector<Key>& keys, vector<bool>& found, size_t groupSize) const {
+    assert(groupSize >= 1);
+    
+    struct Lookup {
+        size_t index;                                   // position in <keys>
+        const TreeNode* node;                           // next node to visit
+        bool fetched;                                   // TRUE once <node>'s contents are prefetched
+    };
+    
+    found.assign(keys.size(), false);
+    if (frozen) {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            found[i] = (frozen->find(keys[i]) != nullptr);
+        }
+        return;
+    }
+    vector<Lookup> group;
+    group.reserve(groupSize);
+    size_t next = 0;
+    for (; next < keys.size() && group.size() < groupSize; ++next) {
+        group.push_back(Lookup{ next, root, true });
+    }
+    
+    while (!group.empty()) {
+        for (size_t i = 0; i < group.size(); ) {
+            auto& lookup = group[i];
+            if (!lookup.fetched) {
+                lookup.node->prefetchContents();
+                lookup.fetched = true;
+                ++i;
+                continue;
+            }
+            
+            bool hit = false;
+            auto child = lookup.node->stepToward(keys[lookup.index], hit);
+            if (child) {
+                prefetch(child);
+                lookup.node = child;
+                lookup.fetched = false;
+                ++i;
+                continue;
+            }
+            
+            found[lookup.index] = hit;
+            if (next < keys.size()) {
+                lookup = Lookup{ next++, root, true };
+                ++i;
+            }
+            else {
+                lookup = group.back();
+                group.pop_back();
+            }
+        }
+    }
+}
+
+// one slot per key, filled by a single shared descent
+size_t BTree::findMany(const vector<Key>& sorted, vector<DataEntry>& out) const {
+    assert(std::is_sorted(sorted.cbegin(), sorted.cend()));
+    
+    vector<const DataEntry*> hits(sorted.size(), nullptr);
+    if (frozen) {
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            hits[i] = frozen->find(sorted[i]);
+        }
+    }
+    else if (!sorted.empty()) {
+        root->findMany(sorted.cbegin(), sorted.cend(), hits.begin());
+    }
+    
+    size_t found = 0;
+    for (auto hit : hits) {
+        if (hit) {
+            out.push_back(*hit);
+            ++found;
+        }
+    }
+    return found;
+}
+
+// verify the whole tree from the root, then the counters and chain ends
+bool BTree::verify(string* failure) const {
+    if (frozen) {
+        string problem;
+        if (frozen->verify(problem) && frozen->size() != size) {
+            problem = "size is " + to_string(size) + " but the frozen index holds " + to_string(frozen->size());
+        }
+        if (failure) {
+            *failure = problem;
+        }
+        return problem.empty();
+    }
+    
+    size_t threads = 1;
+    if (size >= kParallelVerifySize && std::thread::hardware_concurrency() > 1) {
+        threads = std::thread::hardware_concurrency();
+    }
+    
+    auto summary = root->verify(Fence{}, nullptr, floor, threads);
+    if (summary.failure.empty()) {
+        if (summary.entries != size) {
+            summary.failure = "size is " + to_string(size) + " but the tree holds " + to_string(summary.entries);
+        }
+        else if (summary.guessed != pendingLive) {
+            summary.failure = "buffered messages guess " + to_string(summary.guessed) + " but "
+                              + to_string(pendingLive) + " is counted";
+        }
+        else if (summary.tombstones != tombstones) {
+            summary.failure = to_string(tombstones) + " tombstones counted but the tree holds " + to_string(summary.tombstones);
+        }
+        else if (summary.depth != height) {
+            summary.failure = "height is " + to_string(height) + " but leaves are at depth " + to_string(summary.depth);
+        }
+        else if (summary.first->getLeftNeighbor() || summary.last->getRightNeighbor()) {
+            summary.failure = "leaf chain extends past the first or last leaf";
+        }
+    }
+    
+    if (failure) {
+        *failure = summary.failure;
+    }
+    return summary.failure.empty();
+}
+
+// the nodes report themselves; everything the BTree holds outside them is
+// added here
+MemoryReport BTree::memoryReport() const {
+    MemoryReport report{};
+    root->measure(report, 0);
+    if (report.leafNodes) {
+        report.averageLeafOccupancy = static_cast<double>(report.leafEntries)
+                                      / static_cast<double>(report.leafNodes * 2 * kLeafOrder);
+    }
+    
+    lock_guard<mutex> guard{ rankLock };
+    report.treeBytes = sizeof(BTree) + postingLists.capacity() * sizeof(PostingList)
+                       + freeLists.capacity() * sizeof(size_t) + rankIndex.capacity() * sizeof(LeafRank)
+                       + rankCounts.capacity() * sizeof(size_t);
+    for (const auto& list : postingLists) {
+        report.treeBytes += list.footprint();
+    }
+    if (frozen) {
+        report.treeBytes += frozen->footprint();
+    }
+    return report;
+}
+
+// print tree through one buffer, written out in a single pass
 void BTree::print(ostream& os) const {
-    os << kPrintPrefix << "Height = " << height << "  |  Size = " << size << "\n";
-    os << kPrintPrefix << "~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n";
-    root->print(os);
+    OutputBuffer out{ os };
+    out << kPrintPrefix << "Height = " << height << "  |  Size = " << getSize() << "\n";
+    out << kPrintPrefix << "~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n";
+    if (frozen) {
+        frozen->print(out);
+        return;
+    }
+    root->print(out);
 }
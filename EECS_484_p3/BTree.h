@@ -1,13 +1,35 @@
 #ifndef EECS484P3_BTREE_H
 #define EECS484P3_BTREE_H
 
+#include "PostingList.h"                                // for PostingList
+#include "TreeNode.h"                                   // for Fence, MemoryReport
+#include "TreePolicy.h"                                 // for TreePolicy, RestructureStats, TreeContext
 #include "Utilities.h"                                  // for Key alias
+#include <functional>                                   // for function
 #include <iosfwd>                                       // for ostream forward declaration
+#include <limits>                                       // for numeric_limits
+#include <mutex>                                        // for mutex
+#include <string>                                       // for string
+#include <utility>                                      // for pair
 #include <vector>                                       // for vector (forward declaration is difficult)
 
 class DataEntry;                                        // only used as function argument
-class TreeNode;                                         // only used as pointer or function argument
+class FrozenIndex;                                      // only used as pointer
+struct BufferedMessage;                                 // only used as function argument
+class LeafNode;                                         // only used as pointer
 
+// what an upsert or update did to its key
+enum class Upsert {
+    Inserted,                                           // key was absent or dead and now holds the record
+    Updated                                             // key was live and its record was replaced in place
+};
+
+// where a paged range find stopped, handed back to resume it
+struct PageToken {
+    Key lastKey;                                        // largest key returned so far
+    size_t stamp;                                       // modification stamp of the tree the page came from
+    bool exhausted;                                     // TRUE once nothing is left in the range
+};
 
 class BTree {
     public:
@@ -20,24 +42,223 @@ class BTree {
         //   <this> BTree
         ~BTree();
 
+        // [Copy/Move Constructors and Assignment Operators]
+        // MODIFIES: <other>, <rhs> (move versions only)
+        // EFFECTS:  disables copying, since a BTree owns its nodes; moving
+        //   takes over the nodes, counters, modes and policy of <other> or
+        //   <rhs>, which is left an empty BTree with the default modes and
+        //   policy, deallocating whatever <this> held before
+        BTree(const BTree& other) = delete;
+        BTree(BTree&& other);
+        BTree& operator=(const BTree& rhs) = delete;
+        BTree& operator=(BTree&& rhs);
+
         // [Statistic Accessors]
         // EFFECTS:  returns the height of or the number of data entries in
-        //   <this> BTree
+        //   <this> BTree; in buffered mode the size counts every buffered
+        //   insert as adding its key and every buffered delete as removing
+        //   it, and is corrected as each message reaches a leaf, so it is
+        //   exact whenever the buffers are empty
         size_t getHeight() const;
         size_t getSize() const;
 
+        // [Policy Accessor/Modifier]
+        // REQUIRES: under Rebalance::Threshold, 1 <= leafThreshold <=
+        //   kLeafOrder and 1 <= innerThreshold <= kInnerOrder
+        // MODIFIES: <this> (modifier only)
+        // EFFECTS:  returns or replaces the policy that decides how later
+        //   inserts split and deletes rebalance <this> BTree; nodes already
+        //   below the new minimum are left alone until a delete next touches
+        //   them; edge splits never leave a node below the rebalance minimum,
+        //   so under Rebalance::Strict they split evenly
+        const TreePolicy& getPolicy() const;
+        void setPolicy(const TreePolicy& newPolicy);
+
+        // [Restructure Statistics]
+        // EFFECTS:  returns how many splits, borrows, merges and frees inserts
+        //   and deletes have performed on <this> BTree so far
+        const RestructureStats& getStats() const;
+
+        // [Tombstone Count]
+        // EFFECTS:  returns the number of data entries in <this> BTree that
+        //   are marked dead but not yet compacted away
+        size_t getTombstones() const;
+
+        // [Posting Count]
+        // EFFECTS:  returns the number of records held across every posting
+        //   list of <this> BTree in multi-value mode, otherwise 0
+        size_t getPostings() const;
+
         // [Inserter]
         // MODIFIES: <this>
         // EFFECTS:  inserts <newEntry> into <this> BTree if it has a unique
-        //   key, otherwise does nothing
+        //   key, otherwise does nothing; in multi-value mode, adds the record
+        //   of <newEntry> to the posting list of its key instead; a key inside
+        //   the key range of the leaf the previous insert or lazy delete
+        //   reached goes straight to that leaf instead of descending from the
+        //   root
         void insertEntry(const DataEntry& newEntry);
 
         // [Deleter]
         // MODIFIES: <this>, memory pool
         // EFFECTS:  removes <newEntry> from <this> BTree if it exists,
-        //   otherwise does nothing
+        //   otherwise does nothing; in multi-value mode, the whole posting
+        //   list of its key goes with it
         void deleteEntry(const DataEntry& entryToRemove);
 
+        // [Upserter/Updater]
+        // REQUIRES: multi-value mode is off
+        // MODIFIES: <this>
+        // EFFECTS:  finds the leaf for <key> once, then either replaces the
+        //   record of its live entry in place, with <record> or with
+        //   <modify> applied to the old record, or inserts <key> with
+        //   <record> or with <modify> applied to a default record; in
+        //   buffered mode a pending insert is rewritten in its buffer instead;
+        //   returns which of the two happened
+        Upsert upsert(const Key& key, const Record& record);
+        Upsert update(const Key& key, const std::function<Record(const Record&)>& modify);
+
+        // [Multi-Value Mode]
+        // REQUIRES: <this> BTree is empty, and neither lazy deletes nor
+        //   buffering are enabled while the mode is on
+        // MODIFIES: <this>
+        // EFFECTS:  while enabled, every key maps to a sorted posting list of
+        //   records rather than to a single record: the leaf entry for a key
+        //   names its list, which keeps a few records inline and spills larger
+        //   lists to a delta-encoded block, so a key shared by many records is
+        //   stored once
+        void setMultiValue(bool enabled);
+
+        // [Posting Inserter/Deleter]
+        // REQUIRES: multi-value mode is enabled
+        // MODIFIES: <this>, memory pool (deleter only)
+        // EFFECTS:  adds <record> to, or removes <record> from, the posting
+        //   list of <key>, creating the key on its first record and removing
+        //   it with its last; returns TRUE if and only if <this> BTree changed
+        bool insertPosting(const Key& key, const Record& record);
+        bool deletePosting(const Key& key, const Record& record);
+
+        // [Posting Finders]
+        // REQUIRES: multi-value mode is enabled, <end> >= <begin>
+        // EFFECTS:  returns every record posted under <key> in increasing
+        //   order, or every (key, record) pair whose key is in the range
+        //   [<begin>, <end>] (both endpoints inclusive) ordered by key, then
+        //   record
+        std::vector<Record> findPostings(const Key& key) const;
+        std::vector<std::pair<Key, Record>> rangePostings(const Key& begin, const Key& end) const;
+
+        // [Range Deleter]
+        // REQUIRES: <end> >= <begin>
+        // MODIFIES: <this>, memory pool
+        // EFFECTS:  physically removes every data entry, live or dead, whose
+        //   key is in the range [<begin>, <end>] (both endpoints inclusive),
+        //   even in lazy delete mode: <this> BTree is split just before
+        //   <begin> and just after <end>, every leaf and subtree in between
+        //   is freed whole, and the outer pieces are joined back together, so
+        //   only the two boundary paths are rebalanced; returns the number of
+        //   live entries removed
+        size_t deleteRange(const Key& begin, const Key& end);
+
+        // [Tree Splitter]
+        // REQUIRES: multi-value mode is off
+        // MODIFIES: <this>, memory pool
+        // EFFECTS:  moves every data entry, live or dead, whose key is at
+        //   least <key> into a new BTree with the same modes and policy and
+        //   returns it; both trees are cut along the single path to <key>
+        //   and repaired only there, with the leaf chain cut at the seam;
+        //   buffered messages are flushed first; the counters are split by
+        //   walking the leaves of whichever side runs out first, so the cost
+        //   beyond the path is proportional to the smaller side
+        BTree splitAt(const Key& key);
+
+        // [Tree Joiner]
+        // REQUIRES: multi-value mode is off in both trees, every key in
+        //   <rhs> is greater than every key in <this>, the nodes of <rhs>
+        //   meet the rebalance minimum of <this>, <rhs> is not <this>
+        // MODIFIES: <this>, <rhs>, memory pool
+        // EFFECTS:  appends every data entry of <rhs> to <this> BTree, leaving
+        //   <rhs> empty; the shorter tree is hung off the spine of the taller
+        //   one, the leaf chains are linked at the seam and only the nodes
+        //   along it are repaired; buffered messages of both are flushed
+        //   first
+        void join(BTree&& rhs);
+
+        // [Tree Merger]
+        // REQUIRES: multi-value mode is off in both trees, <other> is not
+        //   <this>
+        // MODIFIES: <this>, memory pool
+        // EFFECTS:  inserts every live data entry of <other> into <this> BTree
+        //   as insertEntry would, keeping the record of any key <this> already
+        //   holds live: only the slice of <this> between the smallest and
+        //   largest key of <other> is split off, merged with <other> in one
+        //   pass over both in key order and rebuilt bottom-up before being
+        //   joined back, so the cost is linear in <other> and that slice plus
+        //   two paths, and a delta that overlaps no key of <this> is spliced
+        //   in whole; tombstones inside the slice are dropped and buffered
+        //   messages of <this> are flushed first
+        void mergeFrom(const BTree& other);
+
+        // [Lazy Delete Mode]
+        // REQUIRES: multi-value mode is off if <enabled>
+        // MODIFIES: <this>, memory pool
+        // EFFECTS:  while enabled, deletes only mark their data entry dead in
+        //   place instead of removing it and rebalancing; lookups and range
+        //   finds skip dead entries, and inserting a dead key revives it;
+        //   disabling the mode compacts <this> BTree
+        void setLazyDelete(bool enabled);
+
+        // [Buffered Mode]
+        // REQUIRES: multi-value mode is off if <enabled>
+        // MODIFIES: <this>, memory pool
+        // EFFECTS:  while enabled, inserts and deletes become messages held in
+        //   the buffers of inner nodes and pushed down in batches to the child
+        //   with the most pending work whenever a buffer fills; a message is
+        //   sent without looking for its key, and a duplicate insert or a
+        //   delete of an absent key is dropped once it reaches the leaves;
+        //   deletes reach the leaves as dead entries, as with lazy deletes;
+        //   lookups and range finds apply the buffered messages on their way
+        //   down; disabling the mode flushes every buffer, then compacts
+        //   unless lazy deletes are on
+        void setBuffered(bool enabled);
+
+        // [Compactor]
+        // MODIFIES: <this>, memory pool
+        // EFFECTS:  flushes every buffered message, then physically removes
+        //   every data entry marked dead by a lazy or buffered delete; each
+        //   maximal run of adjacent leaves that leaves underfull is split off,
+        //   rebuilt bottom-up from its remaining entries and joined back, so
+        //   the rest of <this> BTree is only touched along the seams; returns
+        //   the number of dead entries reclaimed
+        size_t compact();
+
+        // [Repacker]
+        // MODIFIES: <this>, memory pool
+        // EFFECTS:  flushes every buffered message, then rebuilds <this>
+        //   BTree bottom-up from its live entries with the leaves as full as
+        //   possible and allocated in key order, so range scans walk memory
+        //   front to back; tombstones are dropped
+        void repack();
+
+        // [Freezer/Thawer]
+        // REQUIRES: multi-value mode is off (freezer only)
+        // MODIFIES: <this>, memory pool
+        // EFFECTS:  replaces the nodes of <this> BTree with a FrozenIndex of
+        //   its live entries: one contiguous sorted array searched through a
+        //   cache-line-blocked Eytzinger array of separators, with no pointers
+        //   to chase; buffered messages are flushed and tombstones dropped
+        //   first; until <this> BTree is thawed every finder and the verifier
+        //   and printer serve from the FrozenIndex, no other modifier may be
+        //   called and the height reads 0; thawing rebuilds the nodes
+        //   bottom-up from the sorted array; each does nothing if <this>
+        //   BTree is already frozen (or thawed)
+        void freeze();
+        void thaw();
+
+        // [Containment Checker]
+        // EFFECTS:  returns TRUE if and only if <this> BTree holds a live data
+        //   entry whose key is <key>
+        bool contains(const Key& key) const;
+
         // [Range Value Finder]
         // REQUIRES: <end> >= <begin>
         // EFFECTS:  returns a sorted list of all data entries in <this> BTree
@@ -45,15 +266,208 @@ class BTree {
         //   inclusive)
         std::vector<DataEntry> rangeFind(const Key& begin, const Key& end) const;
 
+        // [Paged Range Value Finders]
+        // REQUIRES: <end> >= <begin>, <limit> >= 1; <token> is not exhausted
+        //   (resuming finder only)
+        // MODIFIES: <token>
+        // EFFECTS:  returns, in order, the first <limit> live data entries of
+        //   <this> BTree whose key is in the range [<begin>, <end>] (both
+        //   endpoints inclusive), or the next <limit> after the page <token>
+        //   ended with, and sets <token> to where the returned page ended; a
+        //   page costs one descent plus a scan of only the leaves it covers,
+        //   and resuming by key stays correct even if <this> BTree changed in
+        //   between
+        std::vector<DataEntry> rangeFind(const Key& begin, const Key& end, size_t limit, PageToken& token) const;
+        std::vector<DataEntry> resumeRangeFind(const Key& end, size_t limit, PageToken& token) const;
+
+        // [Offset Range Value Finder]
+        // REQUIRES: <end> >= <begin>, <limit> >= 1
+        // MODIFIES: <token>
+        // EFFECTS:  same as the paged range finder, but skips the first
+        //   <offset> live data entries of the range; the skip is two searches
+        //   over a prefix-sum index of the live entries of each leaf, which a
+        //   single entry coming or going without a leaf restructure patches
+        //   in place, and any other modification leaves to be rebuilt in one
+        //   pass over the leaves the next time it is needed; in buffered mode
+        //   the skipped entries are scanned instead
+        std::vector<DataEntry> rangeFindAt(const Key& begin, const Key& end, size_t offset, size_t limit,
+                                           PageToken& token) const;
+
+        // [Page Token Checker]
+        // EFFECTS:  returns TRUE if and only if <this> BTree has not been
+        //   modified since the page that set <token>
+        bool isCurrent(const PageToken& token) const;
+
+        // [Reverse Range Value Finder]
+        // REQUIRES: <end> >= <begin>
+        // EFFECTS:  returns the live data entries of <this> BTree whose key is
+        //   in the range [<begin>, <end>] (both endpoints inclusive) in
+        //   decreasing order, at most <limit> of them: the scan starts at the
+        //   leaf holding <end> and walks left, so taking the last few entries
+        //   of a range never touches the rest of it, nor, in buffered mode,
+        //   collects the messages for it
+        std::vector<DataEntry> reverseRangeFind(const Key& begin, const Key& end,
+                                                size_t limit = std::numeric_limits<size_t>::max()) const;
+
+        // [Interleaved Containment Checker]
+        // REQUIRES: <groupSize> >= 1
+        // MODIFIES: <found>
+        // EFFECTS:  replaces <found> with one flag per key of <keys>, in any
+        //   order, that is TRUE if and only if <this> BTree holds a live data
+        //   entry with that key; up to <groupSize> lookups are in flight at
+        //   once, each prefetching the next node it needs and then yielding to
+        //   the others, so their cache misses overlap instead of queueing
+        void containsMany(const std::vector<Key>& keys, std::vector<bool>& found,
+                          size_t groupSize = kLookupGroupSize) const;
+
+        // [Batch Finder]
+        // REQUIRES: <sorted> is in increasing order
+        // MODIFIES: <out>
+        // EFFECTS:  appends to <out>, in order, the live data entry of every
+        //   key of <sorted> held by <this> BTree and returns how many there
+        //   were; the whole batch shares one descent, each inner node handing
+        //   every child only the keys between its separators, and each leaf
+        //   answering all of its keys in one merge pass
+        size_t findMany(const std::vector<Key>& sorted, std::vector<DataEntry>& out) const;
+
+        // [Memory Reporter]
+        // EFFECTS:  returns the bytes held by the leaves and inner nodes of
+        //   <this> BTree, counting vector capacity as well as what is used,
+        //   and by the BTree itself with its posting lists, rank index and
+        //   frozen layout; the node count at each depth; how full the leaves
+        //   and inner nodes are, as a histogram in tenths; and the average
+        //   leaf occupancy; one walk over every node
+        MemoryReport memoryReport() const;
+
         // [Printer]
         // MODIFIES: <os>
         // EFFECTS:  prints <this> BTree to <os>
         void print(std::ostream& os) const;
 
+        // [Verifier]
+        // MODIFIES: <failure> if it is not nullptr
+        // EFFECTS:  returns TRUE if and only if every structural invariant of
+        //   <this> BTree holds: key ordering, separator bounds, node occupancy
+        //   (no lower than the loosest policy in effect since <this> BTree was
+        //   last rebuilt, since nodes are left alone on a policy switch),
+        //   uniform leaf depth, parent pointers, the leaf neighbor chain and the
+        //   size and height counters; on failure, describes the first violation
+        //   found in <failure>; large trees are checked with one thread per core
+        bool verify(std::string* failure = nullptr) const;
+
     private:
+        // [Finger Search]
+        // MODIFIES: <this>
+        // EFFECTS:  returns the leaf whose key range holds <key>: the leaf
+        //   remembered from the last search if <key> lies in its fence,
+        //   otherwise the leaf found by descending from the root, which is
+        //   then remembered
+        LeafNode* fingerSearch(const Key& key);
+
+        // [Swapper]
+        // MODIFIES: <this>, <other>
+        // EFFECTS:  exchanges the whole state of <this> and <other>
+        void swap(BTree& other);
+
+        // [Context Accessor]
+        // EFFECTS:  returns the policy and restructure counters of <this>
+        //   BTree, which every node routine that may split, rebalance or
+        //   flush is handed
+        TreeContext context();
+
+        // [Leaf Inserter]
+        // REQUIRES: <leaf> is the leaf whose key range holds <newEntry>, which
+        //   is not in <this> BTree
+        // MODIFIES: <this>, memory pool
+        // EFFECTS:  inserts <newEntry> into <leaf>, then picks up the root and
+        //   height after any split it caused
+        void placeEntry(LeafNode* leaf, const DataEntry& newEntry);
+
+        // [Posting List Allocator/Releaser]
+        // MODIFIES: <this>
+        // EFFECTS:  stores a new posting list holding only <first>, reusing a
+        //   released slot if there is one, and returns its index; or frees
+        //   the posting list named by the record of <entry>
+        size_t allocateList(const Record& first);
+        void releaseList(const DataEntry& entry);
+
+        // [Message Sender]
+        // MODIFIES: <this>, memory pool
+        // EFFECTS:  has the root absorb <message>, then picks up the root and
+        //   height after any splits it caused
+        void sendMessage(const BufferedMessage& message);
+
+        // [Buffer Flusher]
+        // MODIFIES: <this>, memory pool
+        // EFFECTS:  pushes every buffered message in <this> BTree down to the
+        //   leaves
+        void flushBuffers();
+
+        // [Limited Scanner]
+        // REQUIRES: <end> >= <begin>
+        // EFFECTS:  returns, in order, the first <limit> live data entries of
+        //   <this> BTree whose key is in the range [<begin>, <end>] (both
+        //   endpoints inclusive), with buffered messages applied
+        std::vector<DataEntry> scan(const Key& begin, const Key& end, size_t limit) const;
+
+        // [Rank Index Builder]
+        // REQUIRES: the caller holds <rankLock>
+        // MODIFIES: the rank index of <this> BTree
+        // EFFECTS:  records the low fence of every leaf and how many live
+        //   data entries it holds, as of the current modification stamp
+        void refreshRanks() const;
+
+        // [Rank Index Patcher]
+        // REQUIRES: the modification that bumped the stamp last changed the
+        //   live entry with <key> by <delta>, and <leafChanges> is what
+        //   leafRestructures() returned before it
+        // MODIFIES: the rank index of <this> BTree
+        // EFFECTS:  applies <delta> to the leaf holding <key> and keeps the
+        //   index current, if it was current before the modification and no
+        //   leaf split, borrowed, merged or was freed since; otherwise leaves
+        //   it to be rebuilt
+        void adjustRanks(const Key& key, long delta, size_t leafChanges);
+
+        // [Leaf Restructure Counter]
+        // EFFECTS:  returns how many leaf splits, borrows, merges and frees
+        //   <this> BTree has made
+        size_t leafRestructures() const;
+
+        // [Bulk Rebuilder]
+        // REQUIRES: <sorted> is strictly increasing and holds only live entries
+        // MODIFIES: <this>, memory pool
+        // EFFECTS:  replaces the contents of <this> BTree with <sorted>, built
+        //   bottom-up with every node evenly filled
+        void rebuild(const std::vector<DataEntry>& sorted);
+
         TreeNode* root;
         size_t height;
         size_t size;
+        size_t tombstones;
+        bool lazyDelete;
+        bool buffered;
+        bool multiValue;
+        FrozenIndex* frozen;                            // read-only layout while frozen, otherwise nullptr
+        LeafNode* finger;                               // last leaf searched, nullptr once stale
+        std::vector<PostingList> postingLists;          // indexed by the records of leaf entries in multi-value mode
+        std::vector<size_t> freeLists;                  // released slots of <postingLists>
+        size_t postings;
+        long pendingLive;                               // summed guesses of the messages in the buffers
+        size_t stamp;                                   // bumped by every modification
+        
+        // a leaf and the lowest key its fence admits
+        struct LeafRank {
+            const LeafNode* leaf;
+            Key low;
+        };
+        mutable std::mutex rankLock;                    // guards the rank index against concurrent readers
+        mutable std::vector<LeafRank> rankIndex;        // built on demand by offset seeks
+        mutable std::vector<size_t> rankCounts;         // Fenwick tree of the live entries of each leaf
+        mutable size_t rankTotal;                       // live entries counted by <rankCounts>
+        mutable size_t rankStamp;                       // stamp <rankIndex> is current at
+        TreePolicy policy;
+        TreePolicy floor;                               // lowest minimums in effect since the last rebuild
+        RestructureStats stats;
 };
 
 #endif
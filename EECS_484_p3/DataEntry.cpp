@@ -5,14 +5,16 @@
 
 // constructor
 DataEntry::DataEntry(const Key& key, const Record record)
-    : key{ key }, record{ record } {
+    : key{ key }, record{ record }, dead{ false } {
 
     assert(record == key);
 }
 
-// implicit Key converter
-DataEntry::operator Key() const {
-    return key;
+// build as usual, then point the record at the posting list
+DataEntry DataEntry::forPostings(const Key& key, size_t list) {
+    DataEntry entry{ key, key };
+    entry.record = static_cast<Record>(list);
+    return entry;
 }
 
 // return record
@@ -20,6 +22,21 @@ const Record* DataEntry::getRecord() const {
     return &record;
 }
 
+// replace record
+void DataEntry::setRecord(const Record& newRecord) {
+    record = newRecord;
+}
+
+// set tombstone flag
+void DataEntry::markDead() {
+    dead = true;
+}
+
+// clear tombstone flag
+void DataEntry::revive() {
+    dead = false;
+}
+
 // equality
 bool DataEntry::operator==(const DataEntry& rhs) const {
     return (key == rhs.key);
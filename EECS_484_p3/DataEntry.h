@@ -11,6 +11,12 @@ class DataEntry {
         //   as <key>
         DataEntry(const Key& key, const Record record);
 
+        // [Posting Entry Factory]
+        // EFFECTS:  returns a data entry for <key> whose record is the index
+        //   <list> of a posting list held by a multi-value BTree instead of
+        //   a copy of <key>
+        static DataEntry forPostings(const Key& key, size_t list);
+
         // [To-Key Converter]
         // EFFECTS:  implicitly converts <this> DataEntry to its key
         operator Key() const;
@@ -20,6 +26,22 @@ class DataEntry {
         //   DataEntry
         const Record* getRecord() const;
 
+        // [Record Modifier]
+        // MODIFIES: <this>
+        // EFFECTS:  replaces the record represented by <this> DataEntry with
+        //   <newRecord>, as upserts and updates do to an entry already in a
+        //   BTree
+        void setRecord(const Record& newRecord);
+
+        // [Tombstone Accessor/Modifiers]
+        // MODIFIES: <this> (modifiers only)
+        // EFFECTS:  returns TRUE if and only if <this> DataEntry has been
+        //   marked dead by a lazy delete; marks <this> DataEntry dead, or
+        //   live again
+        bool isDead() const;
+        void markDead();
+        void revive();
+
         // [Binary Operators]
         // EFFECTS:  returns TRUE if and only if <this> DataEntry compares
         //   equal to, not equal to, less than, greater than, less than or
@@ -35,6 +57,21 @@ class DataEntry {
     private:
         Key key;
         Record record;
+        bool dead;
 };
 
+
+// every comparison in a node search goes through these two, so they are
+// defined here where the search can inline them
+
+// implicit Key converter
+inline DataEntry::operator Key() const {
+    return key;
+}
+
+// return tombstone flag
+inline bool DataEntry::isDead() const {
+    return dead;
+}
+
 #endif
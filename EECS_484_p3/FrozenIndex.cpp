@@ -0,0 +1,167 @@
+#include "FrozenIndex.h"                                // file-specific header
+#include "DataEntry.h"                                  // for DataEntry
+#include "OutputBuffer.h"                               // for OutputBuffer
+#include "Utilities.h"                                  // for Key alias, prefetch, kPrintPrefix
+#include <cassert>                                      // for assert
+#include <limits>                                       // for numeric_limits
+#include <string>                                       // for string, to_string
+#include <vector>                                       // for vector
+
+using std::vector;
+using std::string; using std::to_string;
+using std::numeric_limits;
+
+
+// constructor; blocks are padded with the largest key, which no search
+// ever counts as below what it is after
+FrozenIndex::FrozenIndex(const vector<DataEntry>& sorted)
+    : entries{ sorted }, blocks{}, separators{}, blockAt{} {
+
+    size_t count = (entries.size() + kBlockKeys - 1) / kBlockKeys;
+    blocks.resize(count);
+    for (size_t i = 0; i < count * kBlockKeys; ++i) {
+        blocks[i / kBlockKeys].keys[i % kBlockKeys] = (i < entries.size()) ? Key(entries[i])
+                                                                           : numeric_limits<Key>::max();
+    }
+
+    //slot 0 is unused, so the children of slot k are 2k and 2k + 1
+    separators.resize(count / kBlockKeys + 1);
+    blockAt.resize(count + 1);
+    size_t next = 0;
+    layout(next, 1);
+}
+
+// return number of entries
+size_t FrozenIndex::size() const {
+    return entries.size();
+}
+
+// return every entry
+const vector<DataEntry>& FrozenIndex::getEntries() const {
+    return entries;
+}
+
+// the object and the capacity of its four arrays
+size_t FrozenIndex::footprint() const {
+    return sizeof(FrozenIndex) + entries.capacity() * sizeof(DataEntry) + blocks.capacity() * sizeof(KeyLine)
+           + separators.capacity() * sizeof(KeyLine) + blockAt.capacity() * sizeof(size_t);
+}
+
+// descend to the first block starting past <key> without a data-dependent
+// branch, back up to the block before it, then count inside that block
+size_t FrozenIndex::rank(const Key& key) const {
+    size_t slots = blockAt.size() - 1;
+    size_t slot = 1;
+    while (slot <= slots) {
+        if (slot * kBlockKeys <= slots) {
+            prefetch(&separators[slot]);
+        }
+        slot = 2 * slot + (separator(slot) <= key);
+    }
+    //the right turns taken since the last left one lead past every key
+    //at or below <key>; undoing them and that left turn leaves the answer
+    while (slot & 1) {
+        slot >>= 1;
+    }
+    slot >>= 1;
+
+    size_t after = slot ? blockAt[slot] : blocks.size();
+    if (after == 0) {
+        return 0;
+    }
+    const Key* line = blocks[after - 1].keys;
+    size_t below = 0;
+    for (size_t i = 0; i < kBlockKeys; ++i) {
+        below += (line[i] < key);
+    }
+    return (after - 1) * kBlockKeys + below;
+}
+
+// the rank lands on <key> if it is there; the key is checked in the
+// block just searched, so a miss never touches the entries
+const DataEntry* FrozenIndex::find(const Key& key) const {
+    size_t position = rank(key);
+    if (position >= entries.size() || blocks[position / kBlockKeys].keys[position % kBlockKeys] != key) {
+        return nullptr;
+    }
+    return &entries[position];
+}
+
+// one search, then a walk through contiguous memory
+vector<DataEntry> FrozenIndex::rangeFind(const Key& begin, const Key& end, size_t limit) const {
+    assert(end >= begin);
+
+    vector<DataEntry> results;
+    for (size_t i = rank(begin); i < entries.size() && Key(entries[i]) <= end && results.size() < limit; ++i) {
+        results.push_back(entries[i]);
+    }
+    return results;
+}
+
+// start just past <end> and walk back
+vector<DataEntry> FrozenIndex::reverseRangeFind(const Key& begin, const Key& end, size_t limit) const {
+    assert(end >= begin);
+
+    size_t i = rank(end);
+    if (i < entries.size() && Key(entries[i]) == end) {
+        ++i;
+    }
+    vector<DataEntry> results;
+    for (; i > 0 && Key(entries[i - 1]) >= begin && results.size() < limit; --i) {
+        results.push_back(entries[i - 1]);
+    }
+    return results;
+}
+
+// a line per block, written like a leaf
+void FrozenIndex::print(OutputBuffer& out) const {
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (i % kBlockKeys == 0) {
+            out << kPrintPrefix << "{ ";
+        }
+        else {
+            out << " | ";
+        }
+        out << Key(entries[i]);
+        if (i % kBlockKeys == kBlockKeys - 1 || i + 1 == entries.size()) {
+            out << " }\n";
+        }
+    }
+}
+
+// every entry must be found where it is stored
+bool FrozenIndex::verify(string& failure) const {
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].isDead()) {
+            failure = "frozen entry " + to_string(Key(entries[i])) + " is dead";
+            return false;
+        }
+        if (i > 0 && entries[i - 1] >= entries[i]) {
+            failure = "frozen entries out of order at " + to_string(Key(entries[i]));
+            return false;
+        }
+        if (rank(entries[i]) != i) {
+            failure = "frozen key " + to_string(Key(entries[i])) + " ranked " + to_string(rank(entries[i]))
+                      + " but stored at " + to_string(i);
+            return false;
+        }
+    }
+    failure.clear();
+    return true;
+}
+
+// in-order walk of the implicit tree hands out block first keys in order
+void FrozenIndex::layout(size_t& next, size_t slot) {
+    if (slot >= blockAt.size()) {
+        return;
+    }
+    layout(next, 2 * slot);
+    separators[slot / kBlockKeys].keys[slot % kBlockKeys] = blocks[next].keys[0];
+    blockAt[slot] = next++;
+    layout(next, 2 * slot + 1);
+}
+
+// slots are packed kBlockKeys to a line
+Key FrozenIndex::separator(size_t slot) const {
+    return separators[slot / kBlockKeys].keys[slot % kBlockKeys];
+}
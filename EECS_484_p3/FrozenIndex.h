@@ -0,0 +1,93 @@
+#ifndef EECS484P3_FROZEN_INDEX_H
+#define EECS484P3_FROZEN_INDEX_H
+
+#include "DataEntry.h"                                  // for DataEntry
+#include "Utilities.h"                                  // for Key alias
+#include <string>                                       // for string
+#include <vector>                                       // for vector
+
+class OutputBuffer;                                     // only used as function argument
+
+
+// Immutable, pointer-free copy of the live entries of a BTree. The entries
+// sit in one sorted array; their keys are also packed into cache-line-sized
+// blocks, and the first key of every block is laid out in Eytzinger (BFS)
+// order, so a lookup descends that implicit tree with one branch-free step
+// per level, prefetching the line of descendants a few levels down as it
+// goes, then counts the keys below the one it is after in a single block.
+class FrozenIndex {
+    public:
+        // [Constructor]
+        // REQUIRES: <sorted> is strictly increasing and holds only live entries
+        explicit FrozenIndex(const std::vector<DataEntry>& sorted);
+
+        // [Statistic Accessors]
+        // EFFECTS:  returns the number of data entries in <this> FrozenIndex,
+        //   or all of them in order
+        size_t size() const;
+        const std::vector<DataEntry>& getEntries() const;
+
+        // [Footprint Accessor]
+        // EFFECTS:  returns the bytes held by <this> FrozenIndex, itself
+        //   included
+        size_t footprint() const;
+
+        // [Rank Finder]
+        // EFFECTS:  returns the number of data entries in <this> FrozenIndex
+        //   whose key is less than <key>, which is also the position of the
+        //   first one whose key is at least <key>
+        size_t rank(const Key& key) const;
+
+        // [Single-Value Finder]
+        // EFFECTS:  returns the data entry in <this> FrozenIndex whose key is
+        //   <key>, or nullptr if there is none
+        const DataEntry* find(const Key& key) const;
+
+        // [Range Value Finders]
+        // REQUIRES: <end> >= <begin>
+        // EFFECTS:  returns, in increasing (or decreasing) order, the first
+        //   <limit> data entries whose key is in the range [<begin>, <end>]
+        //   (both endpoints inclusive)
+        std::vector<DataEntry> rangeFind(const Key& begin, const Key& end, size_t limit) const;
+        std::vector<DataEntry> reverseRangeFind(const Key& begin, const Key& end, size_t limit) const;
+
+        // [Printer]
+        // MODIFIES: <out>
+        // EFFECTS:  prints the keys of <this> FrozenIndex to <out>, one block
+        //   per line
+        void print(OutputBuffer& out) const;
+
+        // [Verifier]
+        // MODIFIES: <failure>
+        // EFFECTS:  returns TRUE if and only if the entries are strictly
+        //   increasing and live and every one of them is found at its own
+        //   position; otherwise describes the first violation in <failure>
+        bool verify(std::string& failure) const;
+
+    private:
+        static const constexpr size_t kBlockKeys = 64 / sizeof(Key);   // keys per cache line
+
+        // one cache line of keys; the descendants log2(kBlockKeys) levels
+        // below Eytzinger slot k are slots kBlockKeys * k onward, which fill
+        // exactly one of these
+        struct alignas(64) KeyLine {
+            Key keys[kBlockKeys];
+        };
+
+        // [Layout Builder]
+        // MODIFIES: <this>, <next>
+        // EFFECTS:  fills the subtree of Eytzinger slot <slot> with block first
+        //   keys in order, starting from block <next>
+        void layout(size_t& next, size_t slot);
+
+        // [Slot Accessor]
+        // EFFECTS:  returns the separator stored in Eytzinger slot <slot>
+        Key separator(size_t slot) const;
+
+        std::vector<DataEntry> entries;
+        std::vector<KeyLine> blocks;                    // keys of <entries>, padded with the largest key
+        std::vector<KeyLine> separators;                // first key of each block, 1-based Eytzinger order
+        std::vector<size_t> blockAt;                    // block whose first key sits in each slot
+};
+
+#endif
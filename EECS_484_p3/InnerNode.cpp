@@ -1,29 +1,52 @@
 #include "DataEntry.h"                                  // for DataEntry
 #include "InnerNode.h"                                  // file-specific header
+#include "LeafNode.h"                                   // for LeafNode neighbor accessors
+#include "OutputBuffer.h"                               // for OutputBuffer
 #include "TreeNode.h"                                   // for TreeNode
+#include "TreePolicy.h"                                 // for TreeContext, policy minimums
 #include "Utilities.h"                                  // for size constants, print prefix, Key alias
-#include <algorithm>                                    // for any_of
+#include <algorithm>                                    // for any_of, lower_bound, max, min, upper_bound
 #include <cassert>                                      // for assert
-#include <iostream>                                     // for ostream
-#include <string>                                       // for string
+#include <future>                                       // for async, future
+#include <limits>                                       // for numeric_limits
+#include <map>                                          // for map
+#include <string>                                       // for string, to_string
+#include <utility>                                      // for pair
 #include <vector>                                       // for vector
 
 using std::any_of;
-using std::vector; using std::string;
-using std::ostream;
+using std::vector;
 
 using namespace std;
 
 
 // value constructor
 InnerNode::InnerNode(TreeNode* child1, const Key& key, TreeNode* child2, InnerNode* parent)
-: TreeNode{ parent }, keys{ key }, children{ child1, child2 } {
+: TreeNode{ NodeKind::Inner, parent }, keys{ key }, children{ child1, child2 }, buffer{}, model{} {
     
     assert(child1 && child2);
     assert(*child1 < key && *child2 >= key);
     
     child1->updateParent(this);
     child2->updateParent(this);
+    fenceChildren();
+}
+
+// bulk constructor
+InnerNode::InnerNode(const vector<TreeNode*>& children)
+: TreeNode{ NodeKind::Inner }, keys{}, children{ children }, buffer{}, model{} {
+    
+    assert(children.size() >= 2);
+    
+    keys.reserve(children.size() - 1);
+    for (size_t i = 0; i < children.size(); ++i) {
+        assert(children[i]);
+        if (i != 0) {
+            keys.push_back(children[i]->minKey());
+        }
+        children[i]->updateParent(this);
+    }
+    fenceChildren();
 }
 
 class sortInvariant {
@@ -101,40 +124,161 @@ InnerNode::~InnerNode() {
     }
 }
 
-// print keys, then each node on its own line
-void InnerNode::print(ostream& os, int indent) const {
+// print keys and any buffered messages, then each node on its own line
+void InnerNode::print(OutputBuffer& out, int indent) const {
     assert(indent >= 0);
     
-    os << kPrintPrefix << string(indent, ' ') << "[ ";
-    for (const auto& key : keys) {
-        if (key != keys[0]) {
-            os << " | ";
+    out << kPrintPrefix;
+    out.indent(indent);
+    out << "[ ";
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (i != 0) {
+            out << " | ";
         }
-        os << key;
+        out << keys[i];
     }
-    os << " ]\n";
+    out << " ]";
+    if (!buffer.empty()) {
+        out << "  ( ";
+        for (size_t i = 0; i < buffer.size(); ++i) {
+            if (i != 0) {
+                out << " ";
+            }
+            out << (buffer[i].isDelete ? '-' : '+') << Key(buffer[i].entry);
+        }
+        out << " )";
+    }
+    out << "\n";
     
     for (const auto child : children) {
-        child->print(os, indent + kIndentIncr);
+        child->print(out, indent + kIndentIncr);
     }
     
     assert(satisfiesInvariant());
 }
 
-// ask first child, which must exist
-Key InnerNode::minKey() const {
-    return children.front()->minKey();
-}
-
-// ask last child, which must exist
-Key InnerNode::maxKey() const {
-    return children.back()->maxKey();
+// this node and its three vectors, then every child one level down
+void InnerNode::measure(MemoryReport& report, size_t level) const {
+    if (report.nodesPerLevel.size() <= level) {
+        report.nodesPerLevel.resize(level + 1, 0);
+    }
+    report.nodesPerLevel[level]++;
+    report.innerNodes++;
+    report.innerBytes += sizeof(InnerNode) + keys.capacity() * sizeof(Key)
+                         + children.capacity() * sizeof(TreeNode*) + buffer.capacity() * sizeof(BufferedMessage);
+    report.innerSlackBytes += (keys.capacity() - keys.size()) * sizeof(Key)
+                              + (children.capacity() - children.size()) * sizeof(TreeNode*)
+                              + (buffer.capacity() - buffer.size()) * sizeof(BufferedMessage);
+    report.innerFill[MemoryReport::fillBucket(keys.size(), 2 * kInnerOrder)]++;
+    
+    for (const auto child : children) {
+        child->measure(report, level + 1);
+    }
 }
 
-// ask the child where the data entry with that key would be
-bool InnerNode::contains(const Key& key) const {
-    return (
-            any_of(children.cbegin(), children.cend(), [key](auto n)->bool { return n->contains(key); }));
+// check this node, then the children (in parallel if allowed), then
+// the seams between neighboring children
+SubtreeSummary InnerNode::verify(const Fence& fence, const InnerNode* expectedParent,
+                                 const TreePolicy& policy, size_t threads) const {
+    assert(threads >= 1);
+    
+    SubtreeSummary summary{};
+    string name = "inner node [" + (keys.empty() ? string("<empty>") : to_string(keys.front())) + " ...]";
+    if (getParent() != expectedParent) {
+        summary.failure = name + " has the wrong parent pointer";
+        return summary;
+    }
+    if (getFence() != fence) {
+        summary.failure = name + " caches a stale fence";
+        return summary;
+    }
+    if (children.size() != keys.size() + 1) {
+        summary.failure = name + " has " + to_string(keys.size()) + " keys but "
+        + to_string(children.size()) + " children";
+        return summary;
+    }
+    if (keys.size() > 2 * kInnerOrder || (expectedParent ? keys.size() < policy.innerMinimum() : keys.empty())) {
+        summary.failure = name + " holds " + to_string(keys.size()) + " keys";
+        return summary;
+    }
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if ((i != 0 && keys[i - 1] >= keys[i]) || !fence.contains(keys[i])) {
+            summary.failure = name + " has separator " + to_string(keys[i]) + " out of order";
+            return summary;
+        }
+    }
+    
+    if (buffer.size() > kInnerBufferSize) {
+        summary.failure = name + " buffers " + to_string(buffer.size()) + " messages";
+        return summary;
+    }
+    for (size_t i = 0; i < buffer.size(); ++i) {
+        Key key = buffer[i].entry;
+        if ((i != 0 && Key(buffer[i - 1].entry) >= key) || !fence.contains(key)) {
+            summary.failure = name + " buffers a message for " + to_string(key) + " out of order";
+            return summary;
+        }
+    }
+    
+    // child i covers [keys[i - 1], keys[i]) within this node's own fence
+    vector<Fence> fences(children.size(), fence);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        fences[i].hasHigh = true;
+        fences[i].high = keys[i];
+        fences[i + 1].hasLow = true;
+        fences[i + 1].low = keys[i];
+    }
+    
+    // the children are cut into at most <threads> contiguous groups, each
+    // verified in order on its own task (the first on this thread) and
+    // stopping at its first failure, so a wide node never starts more
+    // threads than it was given
+    vector<SubtreeSummary> results(children.size());
+    size_t groups = std::min(threads, children.size());
+    size_t share = threads / groups;
+    auto verifyGroup = [this, &fences, &policy, &results, groups, share](size_t group) {
+        size_t end = (group + 1) * children.size() / groups;
+        for (size_t i = group * children.size() / groups; i < end; ++i) {
+            results[i] = children[i]->verify(fences[i], this, policy, share);
+            if (!results[i].failure.empty()) {
+                return;
+            }
+        }
+    };
+    vector<future<void>> pending;
+    for (size_t group = 1; group < groups; ++group) {
+        pending.push_back(async(launch::async, verifyGroup, group));
+    }
+    verifyGroup(0);
+    for (auto& task : pending) {
+        task.get();
+    }
+    
+    for (size_t i = 0; i < children.size(); ++i) {
+        if (!results[i].failure.empty()) {
+            return results[i];
+        }
+        if (results[i].depth != results[0].depth) {
+            summary.failure = name + " has leaves at different depths";
+            return summary;
+        }
+        if (i != 0 && (results[i - 1].last->getRightNeighbor() != results[i].first
+                       || results[i].first->getLeftNeighbor() != results[i - 1].last)) {
+            summary.failure = name + " has a broken leaf chain before separator " + to_string(keys[i - 1]);
+            return summary;
+        }
+        summary.entries += results[i].entries;
+        summary.tombstones += results[i].tombstones;
+        summary.guessed += results[i].guessed;
+    }
+    for (const auto& message : buffer) {
+        summary.guessed += message.guess();
+    }
+    
+    summary.depth = results[0].depth + 1;
+    summary.first = results.front().first;
+    summary.last = results.back().last;
+    return summary;
 }
 
 // ask children if they contain
@@ -143,27 +287,145 @@ bool InnerNode::contains(const TreeNode* node) const {
             any_of(children.cbegin(), children.cend(), [node](auto n)->bool { return n->contains(node); }));
 }
 
-// ask the child where the data entry with that key is
-const DataEntry& InnerNode::operator[](const Key& key) const {
-    assert(contains(key));
+// child i holds [keys[i - 1], keys[i]); the outermost children keep the
+// bound this node has on that side
+void InnerNode::fenceChildren() {
+    for (size_t i = 0; i < children.size(); ++i) {
+        fenceChild(i);
+    }
+}
+
+// a child whose fence did not move leaves everything below it alone
+void InnerNode::fenceChild(size_t index) {
+    Fence childFence = getFence();
+    if (index != 0) {
+        childFence.hasLow = true;
+        childFence.low = keys[index - 1];
+    }
+    if (index < keys.size()) {
+        childFence.hasHigh = true;
+        childFence.high = keys[index];
+    }
+    children[index]->updateFence(childFence);
+}
+
+// merge the batch in place; a message for a key already buffered folds
+// into it, so each key keeps one message per buffer, and the guess of the
+// folded message stands in for the two it replaces
+EntryDelta InnerNode::absorb(const vector<BufferedMessage>& batch, const TreeContext& context) {
+    EntryDelta delta{};
+    auto next = buffer.begin();
+    for (const auto& message : batch) {
+        next = std::lower_bound(next, buffer.end(), Key(message.entry),
+                                [](const BufferedMessage& buffered, const Key& k) { return Key(buffered.entry) < k; });
+        if (next != buffer.end() && Key(next->entry) == Key(message.entry)) {
+            BufferedMessage folded = message.after(*next);
+            delta.guessed += folded.guess() - next->guess() - message.guess();
+            *next = folded;
+            ++next;
+        }
+        else {
+            next = buffer.insert(next, message) + 1;
+        }
+    }
     
-    for (const auto child : children) {
-        if (child->contains(key)) {
-            return child->operator[](key);
+    delta += flushUntil(kInnerBufferSize, context);
+    return delta;
+}
+
+// buffer and separators are both sorted, so each child's messages form
+// one run of the buffer; every batch is taken out before any is handed
+// down, since a child only splits while absorbing its own batch, so each
+// batch still fits its child and this node never splits while overfull
+EntryDelta InnerNode::flushUntil(size_t limit, const TreeContext& context) {
+    vector<TreeNode*> targets;
+    vector<vector<BufferedMessage>> batches;
+    while (buffer.size() > limit) {
+        size_t bestChild = 0;
+        size_t bestBegin = 0;
+        size_t bestEnd = 0;
+        size_t runBegin = 0;
+        for (size_t i = 0; i < children.size() && runBegin < buffer.size(); ++i) {
+            size_t runEnd = runBegin;
+            while (runEnd < buffer.size() && (i == keys.size() || Key(buffer[runEnd].entry) < keys[i])) {
+                ++runEnd;
+            }
+            if (runEnd - runBegin > bestEnd - bestBegin) {
+                bestChild = i;
+                bestBegin = runBegin;
+                bestEnd = runEnd;
+            }
+            runBegin = runEnd;
         }
+        
+        targets.push_back(children[bestChild]);
+        batches.emplace_back(buffer.begin() + static_cast<long>(bestBegin),
+                             buffer.begin() + static_cast<long>(bestEnd));
+        buffer.erase(buffer.begin() + static_cast<long>(bestBegin), buffer.begin() + static_cast<long>(bestEnd));
     }
-    assert(false);
+    
+    EntryDelta delta{};
+    for (size_t i = 0; i < targets.size(); ++i) {
+        context.stats.bufferFlushes++;
+        delta += targets[i]->absorb(batches[i], context);
+    }
+    return delta;
 }
 
-vector<DataEntry> InnerNode::rangeFind(const Key& begin, const Key& end) const {
-    // TO DO: implement this function
+// own buffer first, then each child; children split off into a new
+// sibling are flushed by the parent, which visits that sibling later
+EntryDelta InnerNode::flushAll(const TreeContext& context) {
+    EntryDelta delta = flushUntil(0, context);
+    for (size_t i = 0; i < children.size(); ++i) {
+        delta += children[i]->flushAll(context);
+    }
+    return delta;
+}
+
+// preorder, so an ancestor's newer message is in first and each older
+// one found below folds in under it
+void InnerNode::collectMessages(const Key& begin, const Key& end, map<Key, BufferedMessage>& pending) const {
     assert(end >= begin);
     
-    unsigned int pos = 0;
-    while (pos >= this->keys.size() && begin < this->keys[pos])
-    ++pos;
+    auto iter = std::lower_bound(buffer.cbegin(), buffer.cend(), begin,
+                                 [](const BufferedMessage& message, const Key& k) { return Key(message.entry) < k; });
+    for (; iter != buffer.cend() && Key(iter->entry) <= end; ++iter) {
+        auto slot = pending.emplace(Key(iter->entry), *iter);
+        if (!slot.second) {
+            slot.first->second = slot.first->second.after(*iter);
+        }
+    }
+    for (size_t i = childIndex(begin); i <= childIndex(end); ++i) {
+        children[i]->collectMessages(begin, end, pending);
+    }
+}
+// jump straight to the child of the next unanswered key, so children with
+// no keys cost nothing; buffered messages are newer than anything a child
+// finds, so they are applied after, a plain insert only where it found none
+void InnerNode::findMany(vector<Key>::const_iterator first, vector<Key>::const_iterator last,
+                         vector<const DataEntry*>::iterator hits) const {
+    auto runBegin = first;
+    while (runBegin != last) {
+        size_t child = childIndex(*runBegin);
+        auto runEnd = (child == keys.size()) ? last : std::lower_bound(runBegin, last, keys[child]);
+        children[child]->findMany(runBegin, runEnd, hits + (runBegin - first));
+        runBegin = runEnd;
+    }
     
-    return this->children.at(pos)->rangeFind(begin, end);
+    auto message = buffer.cbegin();
+    for (auto key = first; key != last && message != buffer.cend(); ++key) {
+        message = std::lower_bound(message, buffer.cend(), *key,
+                                   [](const BufferedMessage& buffered, const Key& k) { return Key(buffered.entry) < k; });
+        if (message != buffer.cend() && Key(message->entry) == *key) {
+            auto& hit = hits[key - first];
+            if (message->isDelete) {
+                hit = nullptr;
+            }
+            else if (message->replaces || !hit) {
+                hit = &message->entry;
+            }
+        }
+    }
 }
 
 void InnerNode::updateKey(const TreeNode* rightDescendant, const Key& newKey) {
@@ -171,106 +433,272 @@ void InnerNode::updateKey(const TreeNode* rightDescendant, const Key& newKey) {
     auto i = std::find(this->children.begin(), this->children.end(), rightDescendant);
     unsigned long index = std::distance(this->children.begin(), i) - 1;
     this->keys[index] = newKey;
+    fenceChild(index);
+    fenceChild(index + 1);
 }
 
 // use generic delete, then look at number of children to determine
 // if height decreased
-TreeNode* InnerNode::deleteFromRoot(const DataEntry& entryToRemove) {
+TreeNode* InnerNode::deleteFromRoot(const DataEntry& entryToRemove, const TreeContext& context) {
     assert(!getParent());
     assert(contains(entryToRemove));
     
-    deleteEntry(entryToRemove);
-    if (children.size() == 1) {                 // one child means height has shrunk
-        auto newRoot = children.front();
-        children.clear();                       // clear children so not deallocated later
-        assert(satisfiesInvariant());
-        //added this line
-        newRoot->updateParent(nullptr);
-        return newRoot;
-    }
+    deleteEntry(entryToRemove, context);
     assert(satisfiesInvariant());
-    return this;
-}
-
-void InnerNode::insertEntry(const DataEntry& newEntry) {
-    // TO DO: implement this function
-    //keep tracing down using inner node keys
-    if(contains(newEntry)){
-        return;
-    }
-    for (unsigned i = 0; i < keys.size(); ++i) {
-        if (newEntry < keys[i]) {
-            this->children[i]->insertEntry(newEntry);
-            //assert((keys.size() <= 2 * kInnerOrder && (!getParent() || (keys.size() >= kInnerOrder))) || !getParent());
-            return;
-        }
-    }
-    children.back()->insertEntry(newEntry);
-    //assert((keys.size() <= 2 * kInnerOrder && (!getParent() || (keys.size() >= kInnerOrder))) || !getParent());
+    return shrinkRoot();
 }
 
-void InnerNode::deleteEntry(const DataEntry& entryToRemove) {
-    // TO DO: implement this function
-    
-    if(!contains(entryToRemove)){
-        return;
-    }
-    
-    Key getRemovalKey = Key(entryToRemove);
+// one child means height has shrunk; free-at-empty can leave further
+// single-child nodes below, so keep going through them
+TreeNode* InnerNode::shrinkRoot() {
+    assert(!getParent());
     
-    unsigned int i = 0;
-    while (i < keys.size() && getRemovalKey >= keys[i]) {
-        ++i;
+    if (children.size() != 1) {
+        return this;
     }
+    auto newRoot = children.front();
+    children.clear();                           // clear children so not deallocated
+    newRoot->updateParent(nullptr);
+    newRoot->updateFence(Fence{});
+    delete this;
     
-    children[i]->deleteEntry(entryToRemove);
+    return newRoot->isLeaf() ? newRoot : static_cast<InnerNode*>(newRoot)->shrinkRoot();
 }
 
-void InnerNode::insertChild(TreeNode* newChild, const Key& key) {
+void InnerNode::insertChild(TreeNode* newChild, const Key& key, const TreeContext& context) {
     // TO DO: implement this function
     //assert((newChild != nullptr) && newChild->minKey() >= key);
     
     //update key in inner node (look at lecture slides)
     auto upper_bound = std::upper_bound(keys.begin(), keys.end(), key);
-    auto i = children.begin() + (upper_bound - keys.begin()) + 1;
+    size_t position = static_cast<size_t>(upper_bound - keys.begin());
+    auto i = children.begin() + position + 1;
     keys.insert(upper_bound, key);
     children.insert(i, newChild);
     
+    splitIfOverfull(position, context);
+    fenceChildren();
+}
+
+// split once too many keys; the new right half is added to the parent,
+// which may split in turn
+void InnerNode::splitIfOverfull(size_t position, const TreeContext& context) {
     //check if we need to split inner node
     if (keys.size() > 2 * kInnerOrder) {
+        context.stats.innerSplits++;
         
-        auto middle = kInnerOrder + keys.begin();
-        Key newParentValue = *middle;
+        //keys[middle] moves up; everything right of it goes to the new node
+        size_t middle = splitPoint(position, context.policy);
+        Key newParentValue = keys[middle];
         
-        TreeNode* childone = children[kInnerOrder + 1];
-        Key keyone = keys[kInnerOrder + 1];
-        TreeNode* childtwo = children[kInnerOrder + 2];
+        TreeNode* childone = children[middle + 1];
+        Key keyone = keys[middle + 1];
+        TreeNode* childtwo = children[middle + 2];
         InnerNode* keytwo = getParent();
         InnerNode *innerNodeIn = new InnerNode(childone, keyone, childtwo, keytwo);
-        unsigned int begin = kInnerOrder + 2;
-        unsigned int end = kInnerOrder * 2;
         
-        for (unsigned int i = begin; i <= end; i++) {
+        for (size_t i = middle + 2; i < keys.size(); i++) {
             innerNodeIn->children.push_back(children[i + 1]);
             innerNodeIn->keys.push_back(keys[i]);
             innerNodeIn->children.back()->updateParent(innerNodeIn);
         }
-        for (unsigned int i = 0; i < kInnerOrder + 1; i++) {
-            children.pop_back();
-            keys.pop_back();
-        }
+        children.resize(middle + 1);
+        keys.resize(middle);
+        
+        //buffered messages follow the children they are headed for
+        auto firstMoved = std::lower_bound(buffer.begin(), buffer.end(), newParentValue,
+                                           [](const BufferedMessage& message, const Key& k) { return Key(message.entry) < k; });
+        innerNodeIn->buffer.assign(firstMoved, buffer.end());
+        buffer.erase(firstMoved, buffer.end());
+        refitModel(context.policy);
+        innerNodeIn->refitModel(context.policy);
         if (!getParent()) {
             InnerNode *createParent = new InnerNode(this, newParentValue, innerNodeIn);
             innerNodeIn->updateParent(createParent);
             updateParent(createParent);
         }
         else {
-            getParent()->insertChild(innerNodeIn, newParentValue);
+            getParent()->insertChild(innerNodeIn, newParentValue, context);
+        }
+    }
+}
+
+// an empty leaf adds nothing to a join
+static bool isEmptyLeaf(const TreeNode* node) {
+    return (node->isLeaf() && static_cast<const LeafNode*>(node)->size() == 0);
+}
+
+// equal heights meet under a new root unless they merge; otherwise the
+// shorter tree goes in beside the spine of the taller one at its own
+// level, so only that seam needs repair
+TreeNode* InnerNode::join(TreeNode* left, TreeNode* right, const TreeContext& context) {
+    if (!left || !right) {
+        return left ? left : right;
+    }
+    if (isEmptyLeaf(left) || isEmptyLeaf(right)) {
+        auto empty = static_cast<LeafNode*>(isEmptyLeaf(left) ? left : right);
+        auto kept = (empty == left) ? right : left;
+        empty->unlink();
+        delete empty;
+        return kept;
+    }
+    
+    Key seam = right->minKey();
+    LeafNode::link(left->findLeaf(numeric_limits<Key>::max()), right->findLeaf(numeric_limits<Key>::min()));
+    size_t leftHeight = left->height();
+    size_t rightHeight = right->height();
+    TreeNode* root = nullptr;
+    if (leftHeight == rightHeight) {
+        root = mergeOrBalance(left, right) ? left : new InnerNode(left, right->minKey(), right);
+    }
+    else if (leftHeight > rightHeight) {
+        auto parent = static_cast<InnerNode*>(left);
+        for (size_t level = leftHeight; level > rightHeight + 1; --level) {
+            parent = static_cast<InnerNode*>(parent->children.back());
+        }
+        if (!mergeOrBalance(parent->children.back(), right)) {
+            right->updateParent(parent);
+            parent->insertChild(right, right->minKey(), context);
+        }
+        root = left->findRoot();
+    }
+    else {
+        auto parent = static_cast<InnerNode*>(right);
+        for (size_t level = rightHeight; level > leftHeight + 1; --level) {
+            parent = static_cast<InnerNode*>(parent->children.front());
+        }
+        left->updateParent(parent);
+        if (mergeOrBalance(left, parent->children.front())) {
+            parent->children.front() = left;
+        }
+        else {
+            parent->keys.insert(parent->keys.begin(), parent->children.front()->minKey());
+            parent->children.insert(parent->children.begin(), left);
+            parent->splitIfOverfull(0, context);
+        }
+        root = right->findRoot();
+    }
+    
+    //only the seam was restructured; both trees' fences are current elsewhere
+    root->repairFences(seam);
+    return root;
+}
+
+// cut the child holding <key>, then join what lies left of it onto its
+// lower half and what lies right of it onto its upper half
+pair<TreeNode*, TreeNode*> InnerNode::split(TreeNode* root, const Key& key, const TreeContext& context) {
+    assert(root->findRoot() == root);
+    
+    if (root->isLeaf()) {
+        auto leaf = static_cast<LeafNode*>(root);
+        return { leaf, leaf->cutAt(key) };
+    }
+    
+    auto node = static_cast<InnerNode*>(root);
+    assert(node->buffer.empty());
+    size_t index = node->childIndex(key);
+    TreeNode* middle = node->children[index];
+    middle->updateParent(nullptr);
+    TreeNode* leftPart = node->detachChildren(0, index);
+    TreeNode* rightPart = node->detachChildren(index + 1, node->children.size());
+    node->children.clear();
+    delete node;
+    
+    //free-at-empty leaves single-child nodes that may end up on top
+    auto shrink = [](TreeNode* part) {
+        return part->isLeaf() ? part : static_cast<InnerNode*>(part)->shrinkRoot();
+    };
+    auto halves = split(middle, key, context);
+    auto lower = shrink(join(leftPart, halves.first, context));
+    auto upper = shrink(join(halves.second, rightPart, context));
+    
+    //the cut leaves the right edge of the lower tree and the left edge of
+    //the upper one bounded by separators that are no longer there
+    lower->repairFences(numeric_limits<Key>::max());
+    upper->repairFences(numeric_limits<Key>::min());
+    return { lower, upper };
+}
+
+// pool the keys with the separator between the two, then hand out either
+// all of them or half of them to each
+bool InnerNode::mergeOrBalance(TreeNode* left, TreeNode* right) {
+    if (left->isLeaf()) {
+        return LeafNode::mergeOrBalance(static_cast<LeafNode*>(left), static_cast<LeafNode*>(right));
+    }
+    
+    auto leftNode = static_cast<InnerNode*>(left);
+    auto rightNode = static_cast<InnerNode*>(right);
+    assert(leftNode->buffer.empty() && rightNode->buffer.empty());
+    
+    leftNode->keys.push_back(rightNode->minKey());
+    leftNode->keys.insert(leftNode->keys.end(), rightNode->keys.cbegin(), rightNode->keys.cend());
+    leftNode->children.insert(leftNode->children.end(), rightNode->children.cbegin(), rightNode->children.cend());
+    rightNode->keys.clear();
+    rightNode->children.clear();
+    if (leftNode->keys.size() <= 2 * kInnerOrder) {
+        for (auto child : leftNode->children) {
+            child->updateParent(leftNode);
+        }
+        delete rightNode;
+        return true;
+    }
+    
+    //keys[keep] separates the halves and is rebuilt from the right minimum
+    size_t keep = leftNode->keys.size() / 2;
+    rightNode->keys.assign(leftNode->keys.begin() + static_cast<long>(keep) + 1, leftNode->keys.end());
+    rightNode->children.assign(leftNode->children.begin() + static_cast<long>(keep) + 1, leftNode->children.end());
+    leftNode->keys.resize(keep);
+    leftNode->children.resize(keep + 1);
+    for (auto child : leftNode->children) {
+        child->updateParent(leftNode);
+    }
+    for (auto child : rightNode->children) {
+        child->updateParent(rightNode);
+    }
+    return false;
+}
+
+// a lone child stands on its own; more get a new parent with the
+// separators that stood between them
+TreeNode* InnerNode::detachChildren(size_t first, size_t last) {
+    if (first == last) {
+        return nullptr;
+    }
+    if (last - first == 1) {
+        children[first]->updateParent(nullptr);
+        return children[first];
+    }
+    
+    auto piece = new InnerNode(children[first], keys[first], children[first + 1]);
+    for (size_t i = first + 2; i < last; ++i) {
+        piece->keys.push_back(keys[i - 1]);
+        piece->children.push_back(children[i]);
+        children[i]->updateParent(piece);
+    }
+    piece->fenceChildren();
+    return piece;
+}
+
+// even splits send the middle key up; edge splits keep the new node as
+// small as the policy allows when the new child is the first or last one
+// of a node on the left or right spine of the tree
+size_t InnerNode::splitPoint(size_t position, const TreePolicy& policy) const {
+    if (policy.split == Split::Even || (position != 0 && position != 2 * kInnerOrder)) {
+        return kInnerOrder;
+    }
+    
+    bool last = (position == 2 * kInnerOrder);
+    for (auto node = this; node->getParent(); node = node->getParent()) {
+        const auto& siblings = node->getParent()->children;
+        if ((last ? siblings.back() : siblings.front()) != node) {
+            return kInnerOrder;
         }
     }
+    size_t fewest = std::max<size_t>(policy.innerMinimum(), 1);
+    return last ? 2 * kInnerOrder - fewest : fewest;
 }
 
-void InnerNode::deleteChild(TreeNode* childToRemove) {
+void InnerNode::deleteChild(TreeNode* childToRemove, const TreeContext& context) {
     
     // TO DO: implement this function
     
@@ -286,18 +714,44 @@ void InnerNode::deleteChild(TreeNode* childToRemove) {
         }
     }
     
+    delete childToRemove;
+    
     if (distance > 0) {
         unsigned long deletePos = distance - 1;
         this->keys.erase(this->keys.begin() + deletePos);
     }
-    else {
+    else if (!this->keys.empty()) {
         this->keys.erase(this->keys.begin());
     }
     
+    //the child now next to the gap takes over its range
+    if (!this->children.empty()) {
+        this->fenceChild(distance > 0 ? distance - 1 : 0);
+    }
+    
+    const TreePolicy& policy = context.policy;
+    RestructureStats& stats = context.stats;
+    size_t minimum = policy.innerMinimum();
+    
+    //a childless node has nothing left to borrow into or merge, so it is
+    //freed under any policy; it can only arise from a single-child node
+    //left behind by free-at-empty
+    if (this->children.empty() && this->getParent() != nullptr) {
+        stats.innerFrees++;
+        this->getParent()->deleteChild(this, context);
+        return;
+    }
+    
+    //free-at-empty keeps single-child nodes
+    if (policy.rebalance == Rebalance::FreeAtEmpty) {
+        return;
+    }
+    
     //check for 4 cases
-    if (this->keys.size() < kInnerOrder) {
+    if (this->keys.size() < minimum) {
         //first try borrowing leafNode from right sibling
-        if (this->getParent() != nullptr && rightSibling != nullptr && rightSibling->keys.size() > kInnerOrder) {
+        if (this->getParent() != nullptr && rightSibling != nullptr && rightSibling->keys.size() > minimum) {
+            stats.innerBorrows++;
             
             unsigned long sizeDifference = rightSibling->keys.size() - this->keys.size();
             unsigned long numTransferred = sizeDifference / 2;
@@ -308,27 +762,22 @@ void InnerNode::deleteChild(TreeNode* childToRemove) {
                 rightSibling->children[0]->updateParent(this);
                 rightSibling->children.erase(rightSibling->children.begin());
                 
-                //pull down key of parent into this
+                //pull down key of parent into this; it already bounds the
+                //moved child from below
                 Key pulledDownKey = findPullDownKey(this);
                 this->keys.push_back(pulledDownKey);
                 
-                this->updateKey(this->children[this->children.size()-1], pulledDownKey);
-                //check if pulled down key needs to be updated
-                if(this->children[this->children.size()-2]->minKey() < this->keys[this->keys.size()-1]){
-                    this->updateKey(this->children[this->children.size()-1], this->children[this->children.size()-1]->minKey());
-                }
-                
-                //push right sibling's key into parent
+                //erase right sibling's key and push it into parent, which
+                //moves the fences of both siblings
                 Key pushedUpKey = rightSibling->keys[0];
-                this->getParent()->updateKey(rightSibling, pushedUpKey);
-                
-                //erase right sibling's key
                 rightSibling->keys.erase(rightSibling->keys.begin());
+                this->getParent()->updateKey(rightSibling, pushedUpKey);
             }
         }
         //try borrowing leafNode from left sibling
         //problem
-        else if (this->getParent() != nullptr &&  leftSibling != nullptr && leftSibling->keys.size() > kInnerOrder) {
+        else if (this->getParent() != nullptr &&  leftSibling != nullptr && leftSibling->keys.size() > minimum) {
+            stats.innerBorrows++;
             
             unsigned long sizeDifference = leftSibling->children.size() - this->children.size();
             unsigned long numTransferred = 0;
@@ -346,100 +795,80 @@ void InnerNode::deleteChild(TreeNode* childToRemove) {
                 leftSibling->children[leftSibling->children.size() - 1]->updateParent(this);
                 leftSibling->children.pop_back();
                 
-                //pull down key of parent into this
+                //pull down key of parent into this; it already bounds the
+                //moved child from above
                 Key pulledDownKey = findPullDownKey(leftSibling);
                 this->keys.insert(keys.begin(),pulledDownKey);
                 
-                //check if pulled down key needs to be updated
-                if(this->children[0]->minKey() < this->keys[0]){
-                    this->updateKey(this->children[1], this->children[1]->minKey());
-                }
-                
-                //push left sibling's key into parent
+                //erase left sibling's key and push it into parent, which
+                //moves the fences of both siblings
                 Key pushedUpKey = leftSibling->keys[leftSibling->keys.size() - 1];
-                this->getParent()->updateKey(this, pushedUpKey);
-                
-                //erase left sibling's key
                 leftSibling->keys.pop_back();
+                this->getParent()->updateKey(this, pushedUpKey);
             }
         }
         //try merging with right
-        else if (rightSibling != nullptr && rightSibling->keys.size() == kInnerOrder) {
-            this->merger();
+        else if (rightSibling != nullptr && rightSibling->keys.size() <= minimum) {
+            stats.innerMerges++;
+            this->merger(context);
         }
         //try merging with left
-        else if (leftSibling != nullptr && leftSibling->keys.size() == kInnerOrder) {
-            leftSibling->merger();
+        else if (leftSibling != nullptr && leftSibling->keys.size() <= minimum) {
+            stats.innerMerges++;
+            leftSibling->merger(context);
         }
     }
 }
 
-Key InnerNode::getKey() {
-    auto getParent = this->getParent();
+// group the level into runs of at most 2 * kInnerOrder + 1 nodes
+vector<TreeNode*> InnerNode::buildLevel(const vector<TreeNode*>& nodes, const TreePolicy& policy) {
+    assert(!nodes.empty());
     
-    unsigned int i = 0;
-    while (getParent->children.at(i) != this)
-    i++;
+    size_t fanOut = 2 * kInnerOrder + 1;
+    size_t count = (nodes.size() + fanOut - 1) / fanOut;
+    if (count <= 1 && nodes.size() == 1) {
+        return nodes;
+    }
     
-    return getParent->keys[--i];
+    vector<TreeNode*> level;
+    level.reserve(count);
+    auto next = nodes.cbegin();
+    for (size_t i = 0; i < count; ++i) {
+        size_t share = nodes.size() / count + (i < nodes.size() % count ? 1 : 0);
+        auto node = new InnerNode{ vector<TreeNode*>(next, next + static_cast<long>(share)) };
+        node->refitModel(policy);
+        level.push_back(node);
+        next += static_cast<long>(share);
+    }
+    return level;
+}
+
+// only fit under an interpolation policy, so switching back drops models
+// as nodes split
+void InnerNode::refitModel(const TreePolicy& policy) {
+    if (policy.search == Search::Interpolation) {
+        model.fit(keys.cbegin(), keys.cend());
+    }
+    else {
+        model.clear();
+    }
 }
 
-void InnerNode::merger() {
+// the separator between the two siblings comes down between their
+// children; the moved children keep their fences, and deleting the
+// sibling from the parent widens the fence of <this> over its range
+void InnerNode::merger(const TreeContext& context) {
     
     auto sibling = this->getSibling(this, 'R');
-    for(unsigned long i = 0; i < kLeafOrder+1; ++i){
-        
-        //transfer child
-        this->children.push_back(sibling->children[0]);
-        sibling->children[0]->updateParent(this);
-        sibling->children.erase(sibling->children.begin());
-        
-        //pull key from parent
-        this->keys.push_back(sibling->getKey());
-        
-        //check if key of this has to be updated
-        if(this->children[this->keys.size()-1]->minKey() < this->keys[keys.size()-1] ){
-        }
-        else{
-            this->keys[keys.size()-1] = this->children[keys.size()]->minKey();
-        }
-        
-        //find this position in parent
-        unsigned long posInParent = 0;
-        for(unsigned long i = 0; i < this->getParent()->children.size(); ++i){
-            if(this->getParent()->children[i] == this){
-                posInParent = i;
-            }
-        }
-        
-        unsigned long keyInParentPos = posInParent;
-        
-        //update parent's key
-        if(sibling->keys.size() != 0){
-            this->getParent()->keys[keyInParentPos] = sibling->keys[0];
-            sibling->keys.erase(sibling->keys.begin());
-        }
-        else{
-            
-            //testing below block of code
-            //if(this->getParent()->children.size() > kInnerOrder+1){
-            //    //this->getParent()->keys.erase(keys.begin()+posInParent);
-            //}
-            //else{
-             //   this->getParent()->keys.erase(this->getParent()->keys.begin()+keyInParentPos);
-            //}
-            
-            //this->getParent()->keys.erase(this->getParent()->keys.begin()+keyInParentPos);
-            if(this->getParent() != nullptr){
-                this->getParent()->deleteChild(sibling);
-            }
-            else{
-                delete sibling;
-            }
-            return;
-        }
-        
+    
+    this->keys.push_back(findPullDownKey(this));
+    this->keys.insert(this->keys.end(), sibling->keys.begin(), sibling->keys.end());
+    for (auto child : sibling->children) {
+        this->children.push_back(child);
+        child->updateParent(this);
     }
-    delete sibling;
-
+    sibling->keys.clear();
+    sibling->children.clear();
+    
+    this->getParent()->deleteChild(sibling, context);
 }
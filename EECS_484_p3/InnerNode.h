@@ -2,11 +2,16 @@
 #define EECS484P3_INNER_NODE_H
 
 #include "DataEntry.h"                                          // for DataEntry
+#include "SlotModel.h"                                          // for SlotModel
 #include "TreeNode.h"                                           // for TreeNode (base class)
-#include "Utilities.h"                                          // for size constants
-#include <iosfwd>                                               // for ostream forward declaration
+#include "Utilities.h"                                          // for size constants, prefetch
+#include <algorithm>                                            // for lower_bound
+#include <utility>                                              // for pair
+#include <vector>                                               // for vector
 //#include "LeafNode.h"
 
+class OutputBuffer;                                             // only used as function argument
+
 class InnerNode final : public TreeNode {
 public:
     // [Value Constructor]
@@ -16,6 +21,13 @@ public:
     // EFFECTS:  transfers the ownership of <child1> and <child2> to <this>
     InnerNode(TreeNode* child1, const Key& key, TreeNode* child2, InnerNode* parent = nullptr);
     
+    // [Bulk Constructor]
+    // REQUIRES: <children> holds at least two nodes, none of them nullptr,
+    //   whose keys are strictly increasing from one child to the next
+    // EFFECTS:  transfers the ownership of <children> to <this>, using the
+    //   minimum key of every child but the first as a separator
+    explicit InnerNode(const std::vector<TreeNode*>& children);
+    
     // [Destructor]
     // MODIFIES: the children of <this> InnerNode, memory pool
     // EFFECTS:  deallocates all memory associated with each child of <this>
@@ -32,93 +44,149 @@ public:
     // [Delete when Root Node]
     // REQUIRES: <this> InnerNode's parent is nullptr, <entryToRemove> is a
     //   data entry in one of <this> InnerNode's descendants
-    // MODIFIES: <this>, the InnerNodes in the same BTree as <this>
+    // MODIFIES: <this>, the InnerNodes in the same BTree as <this>, the
+    //   stats of <context>
     // EFFECTS:  removes <entryToRemove> from the descendant of <this>
     //   InnerNode where it is located, decreasing the height of the BTree
-    //   whose root is <this> if necessary; after the removal is complete,
+    //   whose root is <this> if necessary, as the policy of <context>
+    //   decides; after the removal is complete,
     //   returns the root of that BTree, which may have changed due to
     //   height decrease
-    TreeNode* deleteFromRoot(const DataEntry& entryToRemove) override;
-    
-    // [Generic Insert]
-    // REQUIRES: no data entry in any of <this> InnerNode's descendants has
-    //   the same key as <newEntry>
-    // MODIFIES: <this>, the TreeNodes in the same BTree as <this>
-    // EFFECTS:  inserts <newEntry> into the appropriate location in one of
-    //   <this> InnerNode's children, increasing the height of the BTree whose
-    //   root is <this> if necessary
-    void insertEntry(const DataEntry& newEntry) override;
-    
-    // [Generic Delete]
-    // REQUIRES: <entryToRemove> is a data entry in one of <this> InnerNode's
-    //   descendants
-    // MODIFIES: <this>, the TreeNodes in the same BTree as <this>
-    // EFFECTS:  removes <entryToRemove> from the descendant of <this>
-    //   InnerNode where it is located, decreasing the height of the BTree
-    //   whose root is <this> if necessary
-    void deleteEntry(const DataEntry& entryToRemove) override;
+    TreeNode* deleteFromRoot(const DataEntry& entryToRemove, const TreeContext& context) override;
     
     // [Child Adder]
     // REQUIRES: <newChild> is not nullptr, the minimum key of <newChild> is
     //   greater than or equal to <key>, the keys of <newChild> or the
     //   descendants of <newChild> are unique among the keys of the descendants
     //   of <this> InnerNode
-    // MODIFIES: <this>, <newChild>, the TreeNodes in the same BTree as <this>
+    // MODIFIES: <this>, <newChild>, the TreeNodes in the same BTree as <this>,
+    //   the stats of <context>
     // EFFECTS:  inserts <child> in the appropriate location of <this> InnerNode
     //   as the right child of a key with value <key>, increasing the height of
-    //   the BTree containing <this> InnerNode if necessary; ownership of
-    //   <newChild> is transferred
-    void insertChild(TreeNode* newChild, const Key& key);
+    //   the BTree containing <this> InnerNode if necessary, as the policy of
+    //   <context> decides; ownership of <newChild> is transferred
+    void insertChild(TreeNode* newChild, const Key& key, const TreeContext& context);
     
     // [Child Deleter]
     // REQUIRES: <childToRemove> is not nullptr, <childToRemove> is a child of
     //   <this> InnerNode
     // MODIFIES: <this>, <childToRemove>, memory pool, the TreeNodes in the
-    //   same BTree as <this>
+    //   same BTree as <this>, the stats of <context>
     // EFFECTS:  removes <childToRemove> from the children of <this> InnerNode
     //   and deallocates the memory associated with that child, decreasing the
-    //   height of the BTree containing <this> InnerNode if necessary
-    void deleteChild(TreeNode* childToRemove);
-    
-    // [Minimum/Maximum Accessors]
-    // EFFECTS:  returns the minimum (or maximum) key of all data entries
-    //   in <this> InnerNode's descendants
-    Key minKey() const override;
-    Key maxKey() const override;
-    
-    // [Containment Checker]
-    // EFFECTS:  returns TRUE if and only if there is a data entry in one of
-    //   <this> InnerNode's descendants whose key is <key> (key version); or
-    //   if <this> InnerNode or any of <this> InnerNode's descendants is
-    //   <node> (node version)
-    bool contains(const Key& key) const override;
-    bool contains(const TreeNode* node) const override;
+    //   height of the BTree containing <this> InnerNode if necessary, as the
+    //   policy of <context> decides
+    void deleteChild(TreeNode* childToRemove, const TreeContext& context);
+    
+    // [Message Absorber]
+    // REQUIRES: <batch> is strictly increasing by key and every key in it
+    //   lies in the key range of <this> InnerNode
+    // MODIFIES: <this>, the TreeNodes in the same BTree as <this>, the
+    //   stats of <context>
+    // EFFECTS:  merges <batch> into the buffer of <this> InnerNode, where a
+    //   message combines with an older one for the same key, then flushes to
+    //   the child with the most pending messages until at most
+    //   kInnerBufferSize remain; returns the change in the numbers of live
+    //   and dead entries below <this>
+    EntryDelta absorb(const std::vector<BufferedMessage>& batch, const TreeContext& context) override;
     
-    // [Single-Value Finder]
-    // REQUIRES: there is a data entry in one of <this> InnerNode's descendants
-    //   whose key is <key>
-    // EFFECTS:  returns the data entry in one of <this> InnerNode's descendants
-    //   whose key is <key>
-    const DataEntry& operator[](const Key& key) const override;
+    // [Buffer Flusher]
+    // MODIFIES: <this>, the TreeNodes in the same BTree as <this>, the
+    //   stats of <context>
+    // EFFECTS:  empties the buffer of <this> InnerNode into its children,
+    //   then flushes each child; returns the change in the numbers of live
+    //   and dead entries below <this>
+    EntryDelta flushAll(const TreeContext& context) override;
     
-    // [Range Value Finder]
+    // [Message Collector]
     // REQUIRES: <end> >= <begin>
-    // EFFECTS:  returns a vector consisting of every data entry in all of <this>
-    //   InnerNode's descendants whose key is in the range [<begin>, <end>] (both
-    //   endpoints inclusive)
-    std::vector<DataEntry> rangeFind(const Key& begin, const Key& end) const override;
+    // MODIFIES: <pending>
+    // EFFECTS:  adds the messages in the buffer of <this> InnerNode whose key
+    //   is in [<begin>, <end>] to <pending>, under any newer one it already
+    //   has for that key, then does the same for every child overlapping
+    //   that range
+    void collectMessages(const Key& begin, const Key& end,
+                         std::map<Key, BufferedMessage>& pending) const override;
+    
+    // [Node Containment Checker]
+    // EFFECTS:  returns TRUE if and only if <this> InnerNode or any of <this>
+    //   InnerNode's descendants is <node>
+    using TreeNode::contains;
+    bool contains(const TreeNode* node) const override;
+    
+    // [Child Routers]
+    // EFFECTS:  returns the child of <this> InnerNode whose key range would
+    //   hold <key>; or returns the first (or last) child
+    TreeNode* childToward(const Key& key);
+    const TreeNode* childToward(const Key& key) const;
+    const TreeNode* firstChild() const;
+    const TreeNode* lastChild() const;
+    
+    // [Fence Derivers]
+    // REQUIRES: <index> is less than the number of children of <this>
+    //   InnerNode (single child deriver only)
+    // MODIFIES: the TreeNodes below <this>
+    // EFFECTS:  gives child i of <this> InnerNode (every one, or only the
+    //   one at <index>) the fence [keys[i - 1], keys[i]), with the outermost
+    //   children keeping the bound of <this> on their side, and carries
+    //   every fence that changed further down
+    void fenceChildren();
+    void fenceChild(size_t index);
+    
+    // [Lookup Steppers]
+    // MODIFIES: <found> (step only)
+    // EFFECTS:  prefetches the separators, children and buffer of <this>
+    //   InnerNode; or settles the lookup of <key> from a message buffered in
+    //   <this>, otherwise returns the child whose range holds <key>
+    void prefetchContents() const;
+    const TreeNode* stepToward(const Key& key, bool& found) const;
+    
+    // [Buffered Message Finders]
+    // EFFECTS:  returns the message <this> InnerNode buffers for <key>, or
+    //   nullptr if there is none
+    const BufferedMessage* bufferedMessage(const Key& key) const;
+    BufferedMessage* bufferedMessage(const Key& key);
+    
+    // [Batch Finder]
+    // REQUIRES: the keys in [<first>, <last>) are sorted, <hits> begins one
+    //   slot per key, every slot nullptr
+    // MODIFIES: <hits>
+    // EFFECTS:  splits the keys by the separators of <this> InnerNode, hands
+    //   each run to its child only, then applies the messages buffered in
+    //   <this> on top: a delete empties the slot of its key, a replacement
+    //   fills it, and a plain insert fills it only if it is still empty
+    void findMany(std::vector<Key>::const_iterator first, std::vector<Key>::const_iterator last,
+                  std::vector<const DataEntry*>::iterator hits) const override;
     
     // [Printer]
     // REQUIRES: <indent> >= 0
-    // MODIFIES: <os>
-    // EFFECTS:  prints <this> TreeNode to <os>
-    void print(std::ostream& os, int indent = 0) const override;
+    // MODIFIES: <out>
+    // EFFECTS:  prints <this> TreeNode to <out>
+    void print(OutputBuffer& out, int indent = 0) const override;
+    
+    // [Subtree Verifier]
+    // REQUIRES: <threads> >= 1
+    // EFFECTS:  checks the keys, occupancy under <policy>, parent and cached
+    //   fence of <this> InnerNode, verifies each child against the fence its
+    //   separators imply, then checks that the children have equal depth and
+    //   that the leaf chain links each child to the next; children are
+    //   verified concurrently when <threads> > 1; returns a summary of the
+    //   subtree
+    SubtreeSummary verify(const Fence& fence, const InnerNode* expectedParent,
+                          const TreePolicy& policy, size_t threads) const override;
+    
+    // [Memory Measurer]
+    // MODIFIES: <report>
+    // EFFECTS:  adds <this> InnerNode, its key, child and buffer storage and
+    //   every node below it to <report>
+    void measure(MemoryReport& report, size_t level) const override;
     
     // [Key Updater]
     // REQUIRES: <rightDescendant> is not nullptr
     // MODIFIES: <this>
     // EFFECTS:  changes the key in <this> InnerNode whose right subtree would
-    //   contain <rightDescendant> to be the value of <newKey>
+    //   contain <rightDescendant> to be the value of <newKey>, and fences the
+    //   two children on either side of it
     void updateKey(const TreeNode* rightDescendant, const Key& newKey);
     
     void setVectors(InnerNode* innerNodeIn, std::vector<TreeNode*>childrenIn, std::vector<Key>keysIn);
@@ -136,14 +204,190 @@ public:
         return children;
     }
     
+    // [Tree Joiner]
+    // REQUIRES: <left> and <right> are each nullptr or the root of a
+    //   separate tree whose non-root nodes meet the minimum of the policy of
+    //   <context>, with every key in <left> less than every key in <right>;
+    //   neither holds buffered messages
+    // MODIFIES: <left>, <right>, the TreeNodes below them, memory pool, the
+    //   stats of <context>
+    // EFFECTS:  combines both trees into one, linking their leaf chains and
+    //   repairing occupancy only along the seam between them; an empty leaf
+    //   is dropped in favor of the other tree; returns the root of the
+    //   result, or nullptr if both are nullptr
+    static TreeNode* join(TreeNode* left, TreeNode* right, const TreeContext& context);
     
+    // [Tree Splitter]
+    // REQUIRES: <root> is the root of a tree whose non-root nodes meet the
+    //   minimum of the policy of <context> and that holds no buffered
+    //   messages
+    // MODIFIES: <root>, the TreeNodes below it, memory pool, the stats of
+    //   <context>
+    // EFFECTS:  divides the tree into one holding every data entry whose key
+    //   is less than <key> and one holding the rest, each with its own leaf
+    //   chain, repairing occupancy only along the path to <key>; returns the
+    //   roots of the two trees in that order, either of which may be an
+    //   empty leaf
+    static std::pair<TreeNode*, TreeNode*> split(TreeNode* root, const Key& key,
+                                                  const TreeContext& context);
     
+    // [Level Builder]
+    // REQUIRES: <nodes> is not empty, holds parentless nodes of equal height
+    //   whose keys are strictly increasing from one node to the next
+    // EFFECTS:  groups <nodes> under as few newly allocated InnerNodes as
+    //   possible, spreading them evenly so none underflows under <policy>,
+    //   and returns the new level; returns <nodes> itself if it holds a
+    //   single node
+    static std::vector<TreeNode*> buildLevel(const std::vector<TreeNode*>& nodes,
+                                             const TreePolicy& policy);
     
 private:
+    // [Root Shrinker]
+    // REQUIRES: <this> InnerNode is the root
+    // MODIFIES: <this>, memory pool
+    // EFFECTS:  while the root has a single child, deallocates it and makes
+    //   that child the root; returns the resulting root
+    TreeNode* shrinkRoot();
+    
+    // [Child Router]
+    // EFFECTS:  returns the index of the child whose key range would hold
+    //   <key>, i.e. the number of separators less than or equal to <key>
+    size_t childIndex(const Key& key) const;
+    
+    // [Overflow Splitter]
+    // REQUIRES: the newest key of <this> InnerNode is at index <position>
+    // MODIFIES: <this>, the TreeNodes in the same BTree as <this>, the
+    //   stats of <context>
+    // EFFECTS:  if <this> InnerNode holds more than 2 * kInnerOrder keys,
+    //   splits it where the policy of <context> decides and adds the new right half
+    //   to the parent, creating a new root if there is none
+    void splitIfOverfull(size_t position, const TreeContext& context);
+    
+    // [Pair Rebalancer]
+    // REQUIRES: <left> and <right> are nodes of equal height, <right> holds
+    //   every key just above those of <left>, and neither has buffered
+    //   messages
+    // MODIFIES: <left>, <right>, their children, memory pool
+    // EFFECTS:  if the contents of both fit in one node, moves those of
+    //   <right> into <left>, deallocates <right> and returns TRUE; otherwise
+    //   spreads the contents evenly over the two and returns FALSE; the
+    //   parent of neither is updated
+    static bool mergeOrBalance(TreeNode* left, TreeNode* right);
+    
+    // [Child Detacher]
+    // REQUIRES: <first> <= <last> <= the number of children of <this>
+    // EFFECTS:  returns nullptr if the range [<first>, <last>) of children
+    //   is empty, the child itself made parentless if it holds one, and
+    //   otherwise a newly allocated, parentless InnerNode adopting those
+    //   children with the separators between them
+    TreeNode* detachChildren(size_t first, size_t last);
+    
+    // [Split Point Chooser]
+    // REQUIRES: <this> InnerNode holds 2 * kInnerOrder + 1 keys, the newest
+    //   of them at index <position>
+    // EFFECTS:  returns the index of the key that moves up when <this>
+    //   InnerNode splits, as the split policy of <policy> decides; that is
+    //   also the number of keys <this> InnerNode keeps
+    size_t splitPoint(size_t position, const TreePolicy& policy) const;
+    
+    // [Message Locator]
+    // EFFECTS:  returns an iterator to the buffered message whose key is
+    //   <key>, or the end of the buffer if there is none
+    std::vector<BufferedMessage>::const_iterator locateMessage(const Key& key) const;
+    
+    // [Buffer Drainer]
+    // MODIFIES: <this>, the TreeNodes in the same BTree as <this>, the
+    //   stats of <context>
+    // EFFECTS:  repeatedly removes the messages headed for the child with
+    //   the most of them until at most <limit> remain buffered, then has
+    //   each of those children absorb its batch; returns the change in the
+    //   numbers of live and dead entries below <this>
+    EntryDelta flushUntil(size_t limit, const TreeContext& context);
+    
+    // [Model Refitter]
+    // MODIFIES: <this>
+    // EFFECTS:  fits the slot model of <this> InnerNode to its separators if
+    //   <policy> searches by interpolation, otherwise drops it
+    void refitModel(const TreePolicy& policy);
+    
+
     std::vector<Key> keys;
     std::vector<TreeNode*> children;
-    Key getKey();
-    void merger();
+    std::vector<BufferedMessage> buffer;                        // sorted by key, newer than anything below
+    SlotModel model;                                            // predicts the slot of a key in <keys>
+    void merger(const TreeContext& context);
 };
 
+
+// the steps below run once per level of every descent, so they are defined
+// here where the traversals in TreeNode.cpp can inline them
+
+// separators are sorted; child i holds [keys[i - 1], keys[i])
+inline size_t InnerNode::childIndex(const Key& key) const {
+    auto after = model.search(keys.cbegin(), keys.cend(), key, [](const Key& separator, const Key& k) { return separator <= k; });
+    return static_cast<size_t>(after - keys.cbegin());
+}
+
+// buffer is sorted by key
+inline std::vector<BufferedMessage>::const_iterator InnerNode::locateMessage(const Key& key) const {
+    auto iter = std::lower_bound(buffer.cbegin(), buffer.cend(), key,
+                                 [](const BufferedMessage& message, const Key& k) { return Key(message.entry) < k; });
+    return (iter != buffer.cend() && Key(iter->entry) == key) ? iter : buffer.cend();
+}
+
+// follow the separators one level
+inline TreeNode* InnerNode::childToward(const Key& key) {
+    return children[childIndex(key)];
+}
+
+// follow the separators one level
+inline const TreeNode* InnerNode::childToward(const Key& key) const {
+    return children[childIndex(key)];
+}
+
+// there is always at least one child
+inline const TreeNode* InnerNode::firstChild() const {
+    return children.front();
+}
+
+// there is always at least one child
+inline const TreeNode* InnerNode::lastChild() const {
+    return children.back();
+}
+
+// separators, children and buffer each live in their own allocation
+inline void InnerNode::prefetchContents() const {
+    prefetch(keys.data());
+    prefetch(children.data());
+    if (!buffer.empty()) {
+        prefetch(buffer.data());
+    }
+}
+
+// a buffered message is newer than anything below it, and even a plain
+// insert leaves its key live
+inline const TreeNode* InnerNode::stepToward(const Key& key, bool& found) const {
+    auto message = bufferedMessage(key);
+    if (message) {
+        found = !message->isDelete;
+        return nullptr;
+    }
+    return childToward(key);
+}
+
+// most inner nodes buffer nothing, so check that before searching
+inline const BufferedMessage* InnerNode::bufferedMessage(const Key& key) const {
+    if (buffer.empty()) {
+        return nullptr;
+    }
+    auto message = locateMessage(key);
+    return (message == buffer.cend()) ? nullptr : &*message;
+}
+
+// same as the const version, handing out the message for replacement
+inline BufferedMessage* InnerNode::bufferedMessage(const Key& key) {
+    auto message = static_cast<const InnerNode*>(this)->bufferedMessage(key);
+    return message ? &buffer[static_cast<size_t>(message - buffer.data())] : nullptr;
+}
+
 #endif
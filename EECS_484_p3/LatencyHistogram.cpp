@@ -0,0 +1,76 @@
+#include "LatencyHistogram.h"                           // file-specific header
+#include <cassert>                                      // for assert
+#include <cmath>                                        // for ceil
+#include <cstdint>                                      // for uint64_t
+
+using std::uint64_t;
+
+
+// constructor
+LatencyHistogram::LatencyHistogram()
+    : buckets{}, total{ 0 }, largest{ 0 } {}
+
+// bump the bucket count, track the exact maximum
+void LatencyHistogram::record(uint64_t nanos) {
+    ++buckets[bucketFor(nanos)];
+    ++total;
+    if (nanos > largest) {
+        largest = nanos;
+    }
+}
+
+// return number of samples
+uint64_t LatencyHistogram::count() const {
+    return total;
+}
+
+// return largest sample
+uint64_t LatencyHistogram::max() const {
+    return largest;
+}
+
+// walk buckets in increasing order until enough samples are covered
+uint64_t LatencyHistogram::percentile(double percent) const {
+    assert(percent >= 0 && percent <= 100);
+
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t needed = static_cast<uint64_t>(std::ceil(percent / 100 * total));
+    if (needed == 0) {
+        needed = 1;
+    }
+
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < kBucketCount; ++i) {
+        seen += buckets[i];
+        if (seen >= needed) {
+            auto value = highestValueIn(i);
+            return (value < largest) ? value : largest;
+        }
+    }
+    return largest;
+}
+
+// small values map to themselves; larger ones to (octave, top bits)
+unsigned LatencyHistogram::bucketFor(uint64_t value) {
+    if (value < 2 * kSubBucketCount) {
+        return static_cast<unsigned>(value);
+    }
+
+    unsigned msb = 63 - static_cast<unsigned>(__builtin_clzll(value));
+    unsigned shift = msb - kSubBucketBits;
+    return shift * kSubBucketCount + static_cast<unsigned>(value >> shift);
+}
+
+// inverse of bucketFor, rounding up to the top of the bucket
+uint64_t LatencyHistogram::highestValueIn(unsigned bucket) {
+    if (bucket < 2 * kSubBucketCount) {
+        return bucket;
+    }
+
+    unsigned shift = bucket / kSubBucketCount - 1;
+    uint64_t sub = bucket % kSubBucketCount + kSubBucketCount;
+    return ((sub + 1) << shift) - 1;
+}
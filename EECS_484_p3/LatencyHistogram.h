@@ -0,0 +1,50 @@
+#ifndef EECS484P3_LATENCY_HISTOGRAM_H
+#define EECS484P3_LATENCY_HISTOGRAM_H
+
+#include <array>                                        // for array
+#include <cstdint>                                      // for uint64_t
+
+
+class LatencyHistogram {
+    public:
+        // [Constructor]
+        // EFFECTS:  creates an empty histogram
+        LatencyHistogram();
+
+        // [Recorder]
+        // MODIFIES: <this>
+        // EFFECTS:  records a single sample of <nanos> nanoseconds in <this>
+        //   LatencyHistogram
+        void record(std::uint64_t nanos);
+
+        // [Statistic Accessors]
+        // EFFECTS:  returns the number of samples recorded in, or the
+        //   largest sample recorded in, <this> LatencyHistogram
+        std::uint64_t count() const;
+        std::uint64_t max() const;
+
+        // [Percentile Calculator]
+        // REQUIRES: 0 <= <percent> <= 100
+        // EFFECTS:  returns the smallest value v such that at least <percent>
+        //   percent of the samples in <this> LatencyHistogram are <= v, up to
+        //   the precision of the bucket containing v; returns 0 if <this>
+        //   LatencyHistogram is empty
+        std::uint64_t percentile(double percent) const;
+
+    private:
+        // values below 2^(kSubBucketBits + 1) get an exact bucket; above that,
+        // every power of two is split into 2^kSubBucketBits linear buckets,
+        // giving a relative error of at most 1 / 2^kSubBucketBits
+        static const constexpr unsigned kSubBucketBits = 5;
+        static const constexpr unsigned kSubBucketCount = 1u << kSubBucketBits;
+        static const constexpr unsigned kBucketCount = (65 - kSubBucketBits) * kSubBucketCount;
+
+        static unsigned bucketFor(std::uint64_t value);
+        static std::uint64_t highestValueIn(unsigned bucket);
+
+        std::array<std::uint64_t, kBucketCount> buckets;
+        std::uint64_t total;
+        std::uint64_t largest;
+};
+
+#endif
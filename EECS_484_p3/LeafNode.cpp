@@ -1,25 +1,52 @@
 #include "DataEntry.h"                                  // for DataEntry
 #include "InnerNode.h"                                  // for InnerNode
 #include "LeafNode.h"                                   // file-specific header
+#include "LeafSlab.h"                                   // for LeafSlab
+#include "OutputBuffer.h"                               // for OutputBuffer
 #include "TreeNode.h"                                   // for TreeNode
+#include "TreePolicy.h"                                 // for TreeContext, policy minimums
 #include "Utilities.h"                                  // for size constants, print prefix, Key alias
-#include <algorithm>                                    // for find
+#include <algorithm>                                    // for count_if, lower_bound, max, remove_if
 #include <cassert>                                      // for assert
-#include <iostream>                                     // for ostream
-#include <numeric>                                      // for numeric_limits
-#include <string>                                       // for string
+#include <limits>                                       // for numeric_limits
+#include <map>                                          // for map
+#include <string>                                       // for string, to_string
 #include <vector>                                       // for vector
 
-using std::find;
 using std::vector;
 using std::numeric_limits;
-using std::ostream;
-using std::string;
+using std::string; using std::to_string;
+
+static const constexpr size_t kScanPrefetchDistance = 4;   // slab cells a range scan requests ahead of itself
+static const constexpr size_t kRoomEntries = 2 * kLeafOrder + 1;   // a full leaf plus the entry an insert adds before splitting
+static const constexpr size_t kRoomOffset =                 // the room follows the node in a slab cell
+    (sizeof(LeafNode) + alignof(DataEntry) - 1) / alignof(DataEntry) * alignof(DataEntry);
 
 
 // constructor
 LeafNode::LeafNode(InnerNode* parent)
-: TreeNode{ parent }, entries{}, leftNeighbor{nullptr}, rightNeighbor{nullptr} {}
+: TreeNode{ NodeKind::Leaf, parent }, room{}, entries{ RoomAllocator<DataEntry>{ &room } }, model{},
+  leftNeighbor{nullptr}, rightNeighbor{nullptr} {}
+
+// a cell of its own, with no room
+void* LeafNode::operator new(size_t bytes) {
+    return LeafSlab::allocate(bytes);
+}
+
+// the cell was already carved out of a slab
+void* LeafNode::operator new(size_t, void* cell) {
+    return cell;
+}
+
+// the header in front of the cell says where it goes back to
+void LeafNode::operator delete(void* leaf) {
+    LeafSlab::release(leaf);
+}
+
+// only reached if construction in a slab cell throws
+void LeafNode::operator delete(void* leaf, void*) {
+    LeafSlab::release(leaf);
+}
 
 void LeafNode::setEntries(LeafNode *ln,vector<DataEntry>entriesIn){
     for(unsigned i = 0; i < entriesIn.size(); ++i){
@@ -37,21 +64,100 @@ void LeafNode::setNeighborsToNull(){
 
 // print keys of data entries surrounded by curly braces, ending
 // newline
-void LeafNode::print(ostream& os, int indent) const {
+void LeafNode::print(OutputBuffer& out, int indent) const {
     assert(indent >= 0);
     
-    os << kPrintPrefix << string(indent, ' ') << "{ ";
-    for (const auto& entry : entries) {
-        if (entry != entries[0]) {
-            os << " | ";
+    out << kPrintPrefix;
+    out.indent(indent);
+    out << "{ ";
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (i != 0) {
+            out << " | ";
+        }
+        if (entries[i].isDead()) {
+            out << '~';
         }
-        os << entry;
+        out << Key(entries[i]);
     }
-    os << " }\n";
+    out << " }\n";
     
     assert(satisfiesInvariant());
 }
 
+// one node, and the entry storage it has reserved
+void LeafNode::measure(MemoryReport& report, size_t level) const {
+    if (report.nodesPerLevel.size() <= level) {
+        report.nodesPerLevel.resize(level + 1, 0);
+    }
+    report.nodesPerLevel[level]++;
+    report.leafNodes++;
+    report.leafEntries += entries.size();
+    report.leafBytes += sizeof(LeafNode) + entries.capacity() * sizeof(DataEntry);
+    report.leafSlackBytes += (entries.capacity() - entries.size()) * sizeof(DataEntry);
+    if (room.storage && !room.lent) {                   // outgrown, but still part of the cell
+        report.leafBytes += room.bytes;
+        report.leafSlackBytes += room.bytes;
+    }
+    report.leafFill[MemoryReport::fillBucket(entries.size(), 2 * kLeafOrder)]++;
+}
+
+// check the cached fence, then walk the entries once checking order and
+// fence, then occupancy
+SubtreeSummary LeafNode::verify(const Fence& fence, const InnerNode* expectedParent,
+                                const TreePolicy& policy, size_t) const {
+    SubtreeSummary summary{};
+    for (const auto& entry : entries) {
+        ++(entry.isDead() ? summary.tombstones : summary.entries);
+    }
+    summary.first = this;
+    summary.last = this;
+    
+    string name = "leaf starting at " + (entries.empty() ? string("<empty>") : to_string(Key(entries.front())));
+    if (getParent() != expectedParent) {
+        summary.failure = name + " has the wrong parent pointer";
+        return summary;
+    }
+    if (getFence() != fence) {
+        summary.failure = name + " caches a stale fence";
+        return summary;
+    }
+    if (entries.size() > 2 * kLeafOrder || (expectedParent && entries.size() < policy.leafMinimum())) {
+        summary.failure = name + " holds " + to_string(entries.size()) + " entries";
+        return summary;
+    }
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (i != 0 && entries[i - 1] >= entries[i]) {
+            summary.failure = name + " is not strictly increasing at " + to_string(Key(entries[i]));
+            return summary;
+        }
+        if (!fence.contains(entries[i])) {
+            summary.failure = name + " holds " + to_string(Key(entries[i])) + " outside its separators";
+            return summary;
+        }
+    }
+    return summary;
+}
+
+// return left neighbor
+LeafNode* LeafNode::getLeftNeighbor() {
+    return leftNeighbor;
+}
+
+// return left neighbor
+const LeafNode* LeafNode::getLeftNeighbor() const {
+    return leftNeighbor;
+}
+
+// return right neighbor
+LeafNode* LeafNode::getRightNeighbor() {
+    return rightNeighbor;
+}
+
+// return right neighbor
+const LeafNode* LeafNode::getRightNeighbor() const {
+    return rightNeighbor;
+}
+
 // data entries are sorted; minimum is first entry's key
 Key LeafNode::minKey() const {
     if (entries.empty()) {
@@ -68,11 +174,6 @@ Key LeafNode::maxKey() const {
     return entries.back();
 }
 
-// TRUE if key is the key of any entry
-bool LeafNode::contains(const Key& key) const {
-    return (find(entries.cbegin(), entries.cend(), key) != entries.cend());
-}
-
 // TRUE if this node is the target
 bool LeafNode::contains(const TreeNode* node) const {
     return (this == node);
@@ -82,23 +183,145 @@ bool LeafNode::contains(const TreeNode* node) const {
 const DataEntry& LeafNode::operator[](const Key& key) const {
     assert(contains(key));
     
-    return *find(entries.cbegin(), entries.cend(), key);
+    return *locate(key);
+}
+
+// dead entries are as good as absent
+DataEntry* LeafNode::findEntry(const Key& key) {
+    auto entry = static_cast<const LeafNode*>(this)->findEntry(key);
+    return entry ? &entries[static_cast<size_t>(entry - entries.data())] : nullptr;
+}
+
+// dead entries are as good as absent
+const DataEntry* LeafNode::findEntry(const Key& key) const {
+    auto iter = locate(key);
+    return (iter == entries.cend() || iter->isDead()) ? nullptr : &*iter;
+}
+
+// only fit under an interpolation policy, so switching back drops models
+// as nodes split
+void LeafNode::refitModel(const TreePolicy& policy) {
+    if (policy.search == Search::Interpolation) {
+        model.fit(entries.cbegin(), entries.cend());
+    }
+    else {
+        model.clear();
+    }
+}
+
+// flag the entry, leave it where it is
+bool LeafNode::markDead(const Key& key) {
+    auto iter = locate(key);
+    if (iter == entries.cend() || iter->isDead()) {
+        return false;
+    }
+    entries[static_cast<size_t>(iter - entries.cbegin())].markDead();
+    return true;
+}
+
+// overwrite a dead entry in place
+bool LeafNode::reviveEntry(const DataEntry& newEntry) {
+    auto iter = locate(newEntry);
+    if (iter == entries.cend() || !iter->isDead()) {
+        return false;
+    }
+    auto& slot = entries[static_cast<size_t>(iter - entries.cbegin())];
+    slot = newEntry;
+    slot.revive();
+    return true;
+}
+
+// squeeze out dead entries in one pass
+size_t LeafNode::purgeTombstones() {
+    auto before = entries.size();
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [](const DataEntry& entry) { return entry.isDead(); }),
+                  entries.end());
+    return before - entries.size();
+}
+
+// only non-root leaves have a lower bound, set by the policy
+bool LeafNode::underflows(const TreePolicy& policy) const {
+    return (getParent() && entries.size() < policy.leafMinimum());
+}
+
+// likewise, as if the dead entries were already purged
+bool LeafNode::underflowsLive(const TreePolicy& policy) const {
+    return (getParent() && entries.size() - deadEntries() < policy.leafMinimum());
+}
+
+// split the entries as evenly as possible over the fewest full-enough leaves
+vector<TreeNode*> LeafNode::buildChain(const vector<DataEntry>& sorted, const TreePolicy& policy) {
+    size_t count = (sorted.size() + 2 * kLeafOrder - 1) / (2 * kLeafOrder);
+    if (count == 0) {
+        count = 1;
+    }
+    
+    auto cells = LeafSlab::allocateRun(count, kRoomOffset + kRoomEntries * sizeof(DataEntry));
+    vector<TreeNode*> leaves;
+    leaves.reserve(count);
+    LeafNode* previous = nullptr;
+    auto next = sorted.cbegin();
+    for (size_t i = 0; i < count; ++i) {
+        size_t share = sorted.size() / count + (i < sorted.size() % count ? 1 : 0);
+        auto leaf = new (cells[i]) LeafNode{};
+        leaf->room.storage = static_cast<char*>(cells[i]) + kRoomOffset;
+        leaf->room.bytes = kRoomEntries * sizeof(DataEntry);
+        leaf->entries.reserve(kRoomEntries);
+        leaf->entries.assign(next, next + static_cast<long>(share));
+        leaf->refitModel(policy);
+        next += static_cast<long>(share);
+        
+        leaf->leftNeighbor = previous;
+        if (previous) {
+            previous->rightNeighbor = leaf;
+        }
+        previous = leaf;
+        leaves.push_back(leaf);
+    }
+    return leaves;
 }
 
 vector<DataEntry> LeafNode::rangeFind(const Key& begin, const Key& end) const {
     // TO DO: implement this function
+    return rangeFind(begin, end, numeric_limits<size_t>::max());
+}
+
+// same scan, cut short once the page is full
+vector<DataEntry> LeafNode::rangeFind(const Key& begin, const Key& end, size_t limit) const {
     assert(begin <= end);
     
+    //leaves built together sit in chain order in one slab, so the ones a
+    //few cells ahead are requested by address without reading anything;
+    //the chain itself is followed a step behind its requests, reading the
+    //links of a leaf only once it was asked for on the step before, which
+    //covers the leaves outside the slab
+    for (size_t i = 1; i < kScanPrefetchDistance; ++i) {
+        prefetchSlabNeighbor(static_cast<long>(i));
+    }
+    auto ahead = rightNeighbor;
+    if (ahead) {
+        prefetch(ahead);
+    }
+    
     auto leaf = this;
     vector<DataEntry> vec;
-    while (leaf) {
+    while (leaf && vec.size() < limit) {
+        leaf->prefetchSlabNeighbor(static_cast<long>(kScanPrefetchDistance));
+        if (ahead) {
+            prefetch(ahead->entries.data());
+            ahead = ahead->rightNeighbor;
+            if (ahead) {
+                prefetch(ahead);
+            }
+        }
         for (auto& idx : leaf->entries) {
             Key key = Key(idx);
             
-            if (key >= begin && end >= key){
+            if (key >= begin && end >= key && !idx.isDead()){
                 vec.push_back(idx);
             }
-            if (end <= key){
+            if (end <= key || vec.size() == limit){
                 return vec;
             }
         }
@@ -107,26 +330,259 @@ vector<DataEntry> LeafNode::rangeFind(const Key& begin, const Key& end) const {
     return vec;
 }
 
+// both sides are sorted, so one forward pass answers every key; repeated
+// keys find the same entry
+void LeafNode::findMany(vector<Key>::const_iterator first, vector<Key>::const_iterator last,
+                        vector<const DataEntry*>::iterator hits) const {
+    auto entry = entries.cbegin();
+    for (; first != last; ++first, ++hits) {
+        while (entry != entries.cend() && Key(*entry) < *first) {
+            ++entry;
+        }
+        if (entry == entries.cend()) {
+            return;
+        }
+        if (Key(*entry) == *first && !entry->isDead()) {
+            *hits = &*entry;
+        }
+    }
+}
+
+// mirror of rangeFind along the left neighbor chain
+vector<DataEntry> LeafNode::reverseRangeFind(const Key& begin, const Key& end, size_t limit) const {
+    assert(begin <= end);
+    
+    for (size_t i = 1; i < kScanPrefetchDistance; ++i) {
+        prefetchSlabNeighbor(-static_cast<long>(i));
+    }
+    auto ahead = leftNeighbor;
+    if (ahead) {
+        prefetch(ahead);
+    }
+    
+    vector<DataEntry> results;
+    for (auto leaf = this; leaf && results.size() < limit; leaf = leaf->leftNeighbor) {
+        leaf->prefetchSlabNeighbor(-static_cast<long>(kScanPrefetchDistance));
+        if (ahead) {
+            prefetch(ahead->entries.data());
+            ahead = ahead->leftNeighbor;
+            if (ahead) {
+                prefetch(ahead);
+            }
+        }
+        for (auto entry = leaf->entries.crbegin(); entry != leaf->entries.crend(); ++entry) {
+            Key key = Key(*entry);
+            if (key < begin || results.size() == limit) {
+                return results;
+            }
+            if (key <= end && !entry->isDead()) {
+                results.push_back(*entry);
+            }
+        }
+    }
+    return results;
+}
+
+// a cell in use or not is still slab memory, so touching it is harmless
+void LeafNode::prefetchSlabNeighbor(long step) const {
+    auto cell = static_cast<const char*>(LeafSlab::neighbor(this, step));
+    if (cell) {
+        prefetch(cell);
+        prefetch(cell + kRoomOffset);
+    }
+}
+
+// count everything physically held
+size_t LeafNode::size() const {
+    return entries.size();
+}
+
+// count only tombstones
+size_t LeafNode::deadEntries() const {
+    return static_cast<size_t>(std::count_if(entries.cbegin(), entries.cend(),
+                                             [](const DataEntry& entry) { return entry.isDead(); }));
+}
+
+// live entries are not contiguous once some are dead, so count them
+size_t LeafNode::liveBefore(const Key& key) const {
+    auto bound = std::lower_bound(entries.cbegin(), entries.cend(), key,
+                                  [](const DataEntry& entry, const Key& k) { return Key(entry) < k; });
+    return static_cast<size_t>(std::count_if(entries.cbegin(), bound,
+                                             [](const DataEntry& entry) { return !entry.isDead(); }));
+}
+
+// skip dead entries while counting
+Key LeafNode::liveKeyAt(size_t rank) const {
+    for (const auto& entry : entries) {
+        if (!entry.isDead() && rank-- == 0) {
+            return entry;
+        }
+    }
+    assert(false);
+    return numeric_limits<Key>::max();
+}
+
+// one binary search to the start of the window, never past this leaf
+void LeafNode::appendLive(const Key& begin, const Key& end, vector<DataEntry>& out) const {
+    assert(begin <= end);
+    
+    auto entry = std::lower_bound(entries.cbegin(), entries.cend(), begin,
+                                  [](const DataEntry& stored, const Key& k) { return Key(stored) < k; });
+    for (; entry != entries.cend() && Key(*entry) <= end; ++entry) {
+        if (!entry->isDead()) {
+            out.push_back(*entry);
+        }
+    }
+}
+
+// the new leaf takes the upper part and everything to its right
+LeafNode* LeafNode::cutAt(const Key& key) {
+    assert(!getParent());
+    
+    auto first = std::lower_bound(entries.begin(), entries.end(), key,
+                                  [](const DataEntry& entry, const Key& k) { return Key(entry) < k; });
+    auto upper = new LeafNode{};
+    upper->entries.assign(first, entries.end());
+    entries.erase(first, entries.end());
+    
+    upper->rightNeighbor = rightNeighbor;
+    if (rightNeighbor) {
+        rightNeighbor->leftNeighbor = upper;
+    }
+    rightNeighbor = nullptr;
+    return upper;
+}
+
+// neighbors close the gap
+void LeafNode::unlink() {
+    if (leftNeighbor) {
+        leftNeighbor->rightNeighbor = rightNeighbor;
+    }
+    if (rightNeighbor) {
+        rightNeighbor->leftNeighbor = leftNeighbor;
+    }
+    leftNeighbor = nullptr;
+    rightNeighbor = nullptr;
+}
+
+// point the two at each other
+void LeafNode::link(LeafNode* left, LeafNode* right) {
+    assert(left && right);
+    
+    left->rightNeighbor = right;
+    right->leftNeighbor = left;
+}
+
+// one leaf if they fit, otherwise split the pooled entries down the middle
+bool LeafNode::mergeOrBalance(LeafNode* left, LeafNode* right) {
+    assert(left->rightNeighbor == right);
+    
+    left->entries.insert(left->entries.end(), right->entries.cbegin(), right->entries.cend());
+    if (left->entries.size() <= 2 * kLeafOrder) {
+        right->unlink();
+        delete right;
+        return true;
+    }
+    
+    auto middle = left->entries.begin() + static_cast<long>(left->entries.size() / 2);
+    right->entries.assign(middle, left->entries.end());
+    left->entries.erase(middle, left->entries.end());
+    return false;
+}
+
+// the left half keeps one extra entry when the new one lands in it; at
+// either end of the chain, edge splits leave the other half as small as
+// the policy allows so monotonic inserts leave full leaves behind
+size_t LeafNode::splitPoint(size_t position, const TreePolicy& policy) const {
+    size_t even = (position > kLeafOrder) ? kLeafOrder : kLeafOrder + 1;
+    if (policy.split == Split::Even) {
+        return even;
+    }
+    
+    size_t fewest = std::max<size_t>(policy.leafMinimum(), 1);
+    if (position == 2 * kLeafOrder && !rightNeighbor) {
+        return 2 * kLeafOrder + 1 - fewest;
+    }
+    if (position == 0 && !leftNeighbor) {
+        return fewest;
+    }
+    return even;
+}
+
+// splits only ever move the upper part of a leaf into a new right
+// neighbor, so follow the chain while the next key belongs there; this is
+// where a message sent blind finds out what it changes, so its guess is
+// taken back
+EntryDelta LeafNode::absorb(const vector<BufferedMessage>& batch, const TreeContext& context) {
+    EntryDelta delta{};
+    LeafNode* leaf = this;
+    for (const auto& message : batch) {
+        Key key = message.entry;
+        delta.guessed -= message.guess();
+        while (leaf->rightNeighbor && key >= leaf->rightNeighbor->minKey()) {
+            leaf = leaf->rightNeighbor;
+        }
+        if (message.isDelete) {
+            if (leaf->markDead(key)) {
+                delta.live--;
+                delta.dead++;
+            }
+            continue;
+        }
+        
+        auto live = leaf->findEntry(key);
+        if (live) {
+            if (message.replaces) {
+                live->setRecord(*message.entry.getRecord());
+            }
+        }
+        else if (leaf->reviveEntry(message.entry)) {
+            delta.live++;
+            delta.dead--;
+        }
+        else {
+            leaf->insertEntry(message.entry, context);
+            delta.live++;
+        }
+    }
+    return delta;
+}
+
+// nothing buffered at a leaf
+EntryDelta LeafNode::flushAll(const TreeContext&) {
+    return EntryDelta{};
+}
+
+// nothing buffered at a leaf
+void LeafNode::collectMessages(const Key&, const Key&, std::map<Key, BufferedMessage>&) const {}
+
 // use generic delete; height can't decrease
-TreeNode* LeafNode::deleteFromRoot(const DataEntry& entryToRemove) {
+TreeNode* LeafNode::deleteFromRoot(const DataEntry& entryToRemove, const TreeContext& context) {
     assert(contains(entryToRemove));
     assert(!getParent());
     
-    deleteEntry(entryToRemove);
+    deleteEntry(entryToRemove, context);
     assert(satisfiesInvariant());
     return this;
 }
 
-void LeafNode::insertEntry(const DataEntry& newEntry) {
+void LeafNode::insertEntry(const DataEntry& newEntry, const TreeContext& context) {
     // TO DO: implement this function
     
-    //check if entry is already in the tree
-    if(this->contains(Key(newEntry))){
+    //check if entry is already in the tree, dead or alive
+    if(locate(newEntry) != entries.cend()){
         return;
     }
     
     //case where leaf node is full
     if(entries.size() >= 2*kLeafOrder){
+        context.stats.leafSplits++;
+        
+        //put DataEntry into correct spot, then cut where the policy says
+        auto upper_bound = std::upper_bound(entries.begin(),entries.end(),newEntry);
+        size_t keep = splitPoint(static_cast<size_t>(upper_bound - entries.begin()), context.policy);
+        entries.insert(upper_bound,newEntry);
+        
 //        
 //        LeafNode *newLeaf = new LeafNode(this->getParent());
         LeafNode *newLeaf = new LeafNode{nullptr};
@@ -139,30 +595,17 @@ void LeafNode::insertEntry(const DataEntry& newEntry) {
         newLeaf->leftNeighbor = this;
         newLeaf->updateParent(this->getParent());
         
-        vector<DataEntry>rightHalf_vector;
         //create second half
-        for(unsigned long i = kLeafOrder; i < entries.size(); ++i){
-            rightHalf_vector.push_back(entries[i]);
-        }
+        vector<DataEntry>rightHalf_vector(entries.begin() + static_cast<long>(keep), entries.end());
         //split first half
-        for(unsigned long i = kLeafOrder; i < 2*kLeafOrder; ++i){
-            this->entries.pop_back();
-        }
-        
-        //put DataEntry into correct spot
-        if(newEntry >= rightHalf_vector[0]){
-            auto upper_bound = std::upper_bound(rightHalf_vector.begin(),rightHalf_vector.end(),newEntry);
-            rightHalf_vector.insert(upper_bound,newEntry);
-        }
-        else{
-            auto upper_bound = std::upper_bound(entries.begin(),entries.end(),newEntry);
-            entries.insert(upper_bound,newEntry);
-        }
+        entries.erase(entries.begin() + static_cast<long>(keep), entries.end());
         
         setEntries(newLeaf,rightHalf_vector);
+        refitModel(context.policy);
+        newLeaf->refitModel(context.policy);
         
         if(this->getParent()){
-            this->getParent()->insertChild(newLeaf,(Key)newLeaf->entries[0]);
+            this->getParent()->insertChild(newLeaf,(Key)newLeaf->entries[0], context);
         }
         else{
             InnerNode *newParent = new InnerNode(this,newLeaf->entries[0],newLeaf);
@@ -182,7 +625,7 @@ void LeafNode::insertEntry(const DataEntry& newEntry) {
 }
 //PROBLEM!!!!!!!!! check piazza post 1110 for failed test case
 //must update common ancestor during merge from a non-sibling
-void LeafNode::deleteEntry(const DataEntry& entryToRemove) {
+void LeafNode::deleteEntry(const DataEntry& entryToRemove, const TreeContext& context) {
     // TO DO: implement this function
     
     if(!this->contains(entryToRemove)){
@@ -191,10 +634,31 @@ void LeafNode::deleteEntry(const DataEntry& entryToRemove) {
     
     auto i = std::lower_bound(this->entries.begin(),this->entries.end(),entryToRemove);
     entries.erase(i);
-    if(this->entries.size() < kLeafOrder && this->getParent() != nullptr){
+    
+    const TreePolicy& policy = context.policy;
+    RestructureStats& stats = context.stats;
+    size_t minimum = policy.leafMinimum();
+    
+    //free-at-empty never borrows or merges; an empty leaf just leaves the chain
+    if(policy.rebalance == Rebalance::FreeAtEmpty){
+        if(this->entries.empty() && this->getParent() != nullptr){
+            if(this->rightNeighbor != nullptr){
+                this->rightNeighbor->leftNeighbor = this->leftNeighbor;
+            }
+            if(this->leftNeighbor != nullptr){
+                this->leftNeighbor->rightNeighbor = this->rightNeighbor;
+            }
+            stats.leafFrees++;
+            this->getParent()->deleteChild(this, context);
+        }
+        return;
+    }
+    
+    if(this->entries.size() < minimum && this->getParent() != nullptr){
         
         //check if we can borrow from right
-        if(this->rightNeighbor != nullptr && this->rightNeighbor->entries.size() > kLeafOrder){
+        if(this->rightNeighbor != nullptr && this->rightNeighbor->entries.size() > minimum){
+            stats.leafBorrows++;
             
             unsigned long sizeDifference = this->rightNeighbor->entries.size() - this->entries.size();
             unsigned long numTransferred = sizeDifference/2;
@@ -215,7 +679,8 @@ void LeafNode::deleteEntry(const DataEntry& entryToRemove) {
             commonAncestor->updateKey(position,updateKey);
         }
         //check if we can borrow from left
-        else if(this->leftNeighbor != nullptr && this->leftNeighbor->entries.size() > kLeafOrder){
+        else if(this->leftNeighbor != nullptr && this->leftNeighbor->entries.size() > minimum){
+            stats.leafBorrows++;
             
             unsigned long sizeDifference = this->leftNeighbor->entries.size() - this->entries.size();
             unsigned long numTransferred = 0;
@@ -244,13 +709,10 @@ void LeafNode::deleteEntry(const DataEntry& entryToRemove) {
             commonAncestor->updateKey(position,updateKey);
         }
         //merge with right
-        else if(this->rightNeighbor != nullptr && this->rightNeighbor->entries.size() == kLeafOrder){
-            for(unsigned int i = 0; i < kLeafOrder; ++i){
-                this->entries.push_back(this->rightNeighbor->entries[i]);
-            }
-            for(unsigned int i = 0; i < kLeafOrder; ++i){
-                this->rightNeighbor->entries.pop_back();
-            }
+        else if(this->rightNeighbor != nullptr){
+            stats.leafMerges++;
+            this->entries.insert(this->entries.end(),this->rightNeighbor->entries.begin(),this->rightNeighbor->entries.end());
+            this->rightNeighbor->entries.clear();
             if(this->rightNeighbor->rightNeighbor != nullptr){
                 this->rightNeighbor->rightNeighbor->leftNeighbor = this;
             }
@@ -268,26 +730,25 @@ void LeafNode::deleteEntry(const DataEntry& entryToRemove) {
                     }
                 }
                 commonAncestor->updateKey(position,updateKey);
-                this->rightNeighbor->getParent()->deleteChild(this->rightNeighbor);
+                this->rightNeighbor->getParent()->deleteChild(this->rightNeighbor, context);
             }
             else{
-                this->getParent()->deleteChild(this->rightNeighbor);
+                this->getParent()->deleteChild(this->rightNeighbor, context);
             }
             
             this->rightNeighbor = temp;
         }
         //merge with left and then delete this
         else{
-            for(unsigned int i = 0; i < kLeafOrder-1; ++i){
-                this->leftNeighbor->entries.push_back(this->entries[i]);
-            }
+            stats.leafMerges++;
+            this->leftNeighbor->entries.insert(this->leftNeighbor->entries.end(),this->entries.begin(),this->entries.end());
             if(this->rightNeighbor != nullptr){
                 this->rightNeighbor->leftNeighbor = this->leftNeighbor;
             }
             if(this->leftNeighbor != nullptr){
                 this->leftNeighbor->rightNeighbor = this->rightNeighbor;
             }
-            this->getParent()->deleteChild(this);
+            this->getParent()->deleteChild(this, context);
         }
     }
 }
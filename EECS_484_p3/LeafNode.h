@@ -2,13 +2,16 @@
 #define EECS484P3_LEAF_NODE_H
 
 #include "DataEntry.h"                                          // for DataEntry
+#include "RoomAllocator.h"                                      // for Room, RoomAllocator
+#include "SlotModel.h"                                          // for SlotModel
 #include "TreeNode.h"                                           // for TreeNode (base class)
-#include "Utilities.h"                                          // for size constants
-#include <iosfwd>                                               // for ostream forward declaration
+#include "Utilities.h"                                          // for size constants, prefetch
+#include <cstddef>                                              // for size_t
 #include <vector>                                               // for vector
 //#include "InnerNode.h"
 
 class InnerNode;                                                // only used as pointer or function argument
+class OutputBuffer;                                             // only used as function argument
 
 
 class LeafNode final : public TreeNode {
@@ -24,69 +27,311 @@ public:
     LeafNode& operator=(const LeafNode& rhs) = delete;
     LeafNode& operator=(LeafNode&& rhs) = delete;
     
+    // [Allocation and Deallocation Functions]
+    // EFFECTS:  LeafNodes get their memory from LeafSlab: a cell of their
+    //   own, or, with a cell argument, a cell of a slab built by buildChain;
+    //   deleting a LeafNode gives its cell back either way
+    static void* operator new(size_t bytes);
+    static void* operator new(size_t bytes, void* cell);
+    static void operator delete(void* leaf);
+    static void operator delete(void* leaf, void* cell);
+    
     // [Delete when Root Node]
     // REQUIRES: <this> LeafNode's parent is nullptr, <entryToRemove> is a
     //   data entry in <this> LeafNode
     // MODIFIES: <this>
     // EFFECTS:  removes <entryToRemove> from <this> LeafNode and returns
     //   <this>
-    TreeNode* deleteFromRoot(const DataEntry& entryToRemove) override;
+    TreeNode* deleteFromRoot(const DataEntry& entryToRemove, const TreeContext& context) override;
     
     // [Generic Insert]
     // REQUIRES: no data entry in <this> LeafNode has the same key as
     //   <newEntry>
-    // MODIFIES: <this>
+    // MODIFIES: <this>, the stats of <context>
     // EFFECTS:  inserts <newEntry> into the appropriate location in <this>
     //   LeafNode, increasing the height of the BTree whose root is <this>
-    //   if necessary
-    void insertEntry(const DataEntry& newEntry) override;
+    //   if necessary; a split divides the entries as the policy of
+    //   <context> decides
+    void insertEntry(const DataEntry& newEntry, const TreeContext& context);
     
     // [Generic Delete]
     // REQUIRES: <entryToRemove> is a data entry in <this> LeafNode
-    // MODIFIES: <this>
+    // MODIFIES: <this>, the stats of <context>
     // EFFECTS:  removes <entryToRemove> from <this> LeafNode, decreasing the
-    //   height of the BTree whose root is <this> if necessary
-    void deleteEntry(const DataEntry& entryToRemove) override;
+    //   height of the BTree whose root is <this> if necessary; underflow is
+    //   handled as the policy of <context> decides
+    void deleteEntry(const DataEntry& entryToRemove, const TreeContext& context);
+    
+    // [Message Absorber]
+    // REQUIRES: <batch> is strictly increasing by key and every key in it
+    //   lies in the key range of <this> LeafNode
+    // MODIFIES: <this>, the TreeNodes in the same BTree as <this>, the
+    //   stats of <context>
+    // EFFECTS:  inserts or revives the entry of every insert message whose
+    //   key is not live, overwrites the live entry of every replacement and
+    //   marks the entry of every delete message dead, splitting as needed;
+    //   returns the change in the numbers of live and dead entries
+    EntryDelta absorb(const std::vector<BufferedMessage>& batch, const TreeContext& context) override;
+    
+    // [Buffer Flusher]
+    // EFFECTS:  returns no change; leaves have no buffer
+    EntryDelta flushAll(const TreeContext& context) override;
+    
+    // [Message Collector]
+    // EFFECTS:  does nothing; leaves have no buffer
+    void collectMessages(const Key& begin, const Key& end,
+                         std::map<Key, BufferedMessage>& pending) const override;
     
     // [Minimum/Maximum Accessors]
     // EFFECTS:  returns the minimum (or maximum) key of all data entries
     //   in <this> LeafNode
-    Key minKey() const override;
-    Key maxKey() const override;
+    Key minKey() const;
+    Key maxKey() const;
     
     // [Containment Checker]
-    // EFFECTS:  returns TRUE if and only if there is a data entry in <this>
-    //   LeafNode whose key is <key> (key version); or if <this> LeafNode is
-    //   <node> (node version)
-    bool contains(const Key& key) const override;
+    // EFFECTS:  returns TRUE if and only if there is a live data entry in
+    //   <this> LeafNode whose key is <key> (key version); or if <this>
+    //   LeafNode is <node> (node version)
+    bool contains(const Key& key) const;
     bool contains(const TreeNode* node) const override;
     
     // [Single-Value Finder]
     // REQUIRES: there is a data entry in <this> LeafNode whose key is <key>
     // EFFECTS:  returns the data entry in <this> LeafNode whose key is <key>
-    const DataEntry& operator[](const Key& key) const override;
+    const DataEntry& operator[](const Key& key) const;
+    
+    // [Entry Locator]
+    // EFFECTS:  returns the live data entry in <this> LeafNode whose key is
+    //   <key>, or nullptr if there is none
+    DataEntry* findEntry(const Key& key);
+    const DataEntry* findEntry(const Key& key) const;
     
     // [Range Value Finder]
     // REQUIRES: <end> >= <begin>
-    // EFFECTS:  returns a vector consisting of every data entry in <this>
-    //   LeafNode whose key is in the range [<begin>, <end>] (both endpoints
-    //   inclusive)
-    std::vector<DataEntry> rangeFind(const Key& begin, const Key& end) const override;
+    // EFFECTS:  returns a vector consisting of every live data entry in
+    //   <this> LeafNode or the leaves to its right whose key is in the range
+    //   [<begin>, <end>] (both endpoints inclusive), prefetching the next
+    //   few leaves of the chain while it scans
+    std::vector<DataEntry> rangeFind(const Key& begin, const Key& end) const;
+    
+    // [Limited Range Value Finder]
+    // REQUIRES: <end> >= <begin>
+    // EFFECTS:  returns the first <limit> live data entries the scan above
+    //   would, stopping as soon as it has them
+    std::vector<DataEntry> rangeFind(const Key& begin, const Key& end, size_t limit) const;
+    
+    // [Reverse Range Value Finder]
+    // REQUIRES: <end> >= <begin>
+    // EFFECTS:  returns, in decreasing order, the live data entries in <this>
+    //   LeafNode or the leaves to its left whose key is in the range
+    //   [<begin>, <end>] (both endpoints inclusive), stopping once <limit>
+    //   have been found; the scan walks the left neighbor chain and
+    //   prefetches the next few leaves of it
+    std::vector<DataEntry> reverseRangeFind(const Key& begin, const Key& end, size_t limit) const;
+    
+    // [Lookup Steppers]
+    // MODIFIES: <found> (step only)
+    // EFFECTS:  prefetches the entries of <this> LeafNode; or settles the
+    //   lookup of <key> by searching them, always returning nullptr
+    void prefetchContents() const;
+    const TreeNode* stepToward(const Key& key, bool& found) const;
+    
+    // [Batch Finder]
+    // REQUIRES: the keys in [<first>, <last>) are sorted, <hits> begins one
+    //   slot per key, every slot nullptr
+    // MODIFIES: <hits>
+    // EFFECTS:  points the slot of every key in [<first>, <last>) that has a
+    //   live data entry in <this> LeafNode at that entry, in one merge pass
+    void findMany(std::vector<Key>::const_iterator first, std::vector<Key>::const_iterator last,
+                  std::vector<const DataEntry*>::iterator hits) const override;
     
     // [Printer]
     // REQUIRES: <indent> >= 0
-    // MODIFIES: <os>
-    // EFFECTS:  prints <this> TreeNode to <os>
-    void print(std::ostream& os, int indent = 0) const override;
+    // MODIFIES: <out>
+    // EFFECTS:  prints <this> TreeNode to <out>
+    void print(OutputBuffer& out, int indent = 0) const override;
+    
+    // [Subtree Verifier]
+    // EFFECTS:  checks that the entries of <this> LeafNode are strictly
+    //   increasing, lie inside <fence> and respect the occupancy bounds of
+    //   <policy>, that the parent of <this> LeafNode is <expectedParent>
+    //   and that its cached fence is <fence>; returns a summary of <this>
+    //   LeafNode
+    SubtreeSummary verify(const Fence& fence, const InnerNode* expectedParent,
+                          const TreePolicy& policy, size_t threads) const override;
+    
+    // [Memory Measurer]
+    // MODIFIES: <report>
+    // EFFECTS:  adds <this> LeafNode and its entry storage to <report>
+    void measure(MemoryReport& report, size_t level) const override;
+    
+    // [Neighbor Accessors]
+    // EFFECTS:  returns the leaf immediately to the left (or right) of <this>
+    //   LeafNode in the leaf chain, or nullptr if there is none
+    LeafNode* getLeftNeighbor();
+    const LeafNode* getLeftNeighbor() const;
+    LeafNode* getRightNeighbor();
+    const LeafNode* getRightNeighbor() const;
     
     void setEntries(LeafNode *ln,std::vector<DataEntry>entriesIn);
     
     void setNeighborsToNull();
     
+    // [Tombstone Marker]
+    // MODIFIES: <this>
+    // EFFECTS:  marks the live data entry in <this> LeafNode whose key is
+    //   <key> as dead, leaving it in place; returns TRUE if and only if such
+    //   an entry existed
+    bool markDead(const Key& key);
+    
+    // [Tombstone Reviver]
+    // MODIFIES: <this>
+    // EFFECTS:  if <this> LeafNode holds a dead data entry with the same key
+    //   as <newEntry>, replaces it with a live copy of <newEntry> and returns
+    //   TRUE; otherwise returns FALSE
+    bool reviveEntry(const DataEntry& newEntry);
+    
+    // [Tombstone Purger]
+    // MODIFIES: <this>
+    // EFFECTS:  physically removes every dead data entry from <this> LeafNode
+    //   without rebalancing and returns how many were removed
+    size_t purgeTombstones();
+    
+    // [Occupancy Accessors]
+    // EFFECTS:  returns the number of data entries, live or dead, in <this>
+    //   LeafNode (or only the dead ones)
+    size_t size() const;
+    size_t deadEntries() const;
+    
+    // [Rank Helpers]
+    // REQUIRES: <rank> is less than the number of live data entries in <this>
+    //   LeafNode (key finder only)
+    // EFFECTS:  returns the number of live data entries in <this> LeafNode
+    //   whose key is less than <key>, or the key of the live data entry
+    //   preceded by exactly <rank> others
+    size_t liveBefore(const Key& key) const;
+    Key liveKeyAt(size_t rank) const;
+    
+    // [Leaf Window Finder]
+    // REQUIRES: <end> >= <begin>
+    // MODIFIES: <out>
+    // EFFECTS:  appends to <out>, in order, the live data entries of <this>
+    //   LeafNode alone whose key is in the range [<begin>, <end>] (both
+    //   endpoints inclusive)
+    void appendLive(const Key& begin, const Key& end, std::vector<DataEntry>& out) const;
+    
+    // [Leaf Cutter]
+    // REQUIRES: <this> LeafNode has no parent
+    // MODIFIES: <this>, the leaf to the right of <this>
+    // EFFECTS:  moves every data entry of <this> LeafNode whose key is at
+    //   least <key> into a newly allocated, parentless leaf that takes over
+    //   the right neighbor of <this>, then cuts the chain between the two so
+    //   <this> ends one chain and the new leaf starts another; returns the
+    //   new leaf, which may be empty, as may <this>
+    LeafNode* cutAt(const Key& key);
+    
+    // [Chain Unlinker]
+    // MODIFIES: <this>, the neighbors of <this>
+    // EFFECTS:  removes <this> LeafNode from the leaf chain, linking its
+    //   neighbors to each other
+    void unlink();
+    
+    // [Chain Linker]
+    // REQUIRES: neither <left> nor <right> is nullptr
+    // MODIFIES: <left>, <right>
+    // EFFECTS:  makes <right> the right neighbor of <left> and <left> the
+    //   left neighbor of <right>
+    static void link(LeafNode* left, LeafNode* right);
+    
+    // [Pair Rebalancer]
+    // REQUIRES: <right> is the right neighbor of <left>, every key in <left>
+    //   is less than every key in <right>
+    // MODIFIES: <left>, <right>, the leaf chain, memory pool
+    // EFFECTS:  if the entries of both fit in one leaf, moves those of
+    //   <right> into <left>, unlinks and deallocates <right> and returns
+    //   TRUE; otherwise spreads the entries evenly over the two leaves and
+    //   returns FALSE; the parent of neither is updated
+    static bool mergeOrBalance(LeafNode* left, LeafNode* right);
+    
+    // [Underflow Checker]
+    // EFFECTS:  returns TRUE if and only if <this> LeafNode is not the root
+    //   and holds fewer data entries than <policy> allows (or would, once
+    //   its dead entries were purged)
+    bool underflows(const TreePolicy& policy) const;
+    bool underflowsLive(const TreePolicy& policy) const;
+    
+    // [Chain Builder]
+    // REQUIRES: <sorted> is strictly increasing
+    // EFFECTS:  returns newly allocated, parentless leaves linked into a
+    //   neighbor chain that together hold <sorted> in order, spreading the
+    //   entries evenly so no leaf but a lone one underflows under <policy>;
+    //   the leaves come from one LeafSlab in chain order, each followed by
+    //   room for a full leaf of entries, so a scan walks memory front to
+    //   back; returns a single empty leaf if <sorted> is empty
+    static std::vector<TreeNode*> buildChain(const std::vector<DataEntry>& sorted,
+                                             const TreePolicy& policy);
+    
 private:
-    std::vector<DataEntry> entries;
+    // [Split Point Chooser]
+    // REQUIRES: <this> LeafNode is full, <position> <= 2 * kLeafOrder
+    // EFFECTS:  returns how many of the 2 * kLeafOrder + 1 entries <this>
+    //   LeafNode holds once a new entry lands at index <position> stay in
+    //   it when it splits, as the split policy of <policy> decides
+    size_t splitPoint(size_t position, const TreePolicy& policy) const;
+    
+    // [Entry Locator]
+    // EFFECTS:  returns an iterator to the live or dead data entry in <this>
+    //   LeafNode whose key is <key>, or the end of entries if there is none
+    std::vector<DataEntry, RoomAllocator<DataEntry>>::const_iterator locate(const Key& key) const;
+    
+    // [Slab Prefetcher]
+    // EFFECTS:  prefetches the leaf <step> cells away from <this> LeafNode in
+    //   its LeafSlab, and the room for its entries, by address alone; does
+    //   nothing if there is no such cell
+    void prefetchSlabNeighbor(long step) const;
+    
+    // [Model Refitter]
+    // MODIFIES: <this>
+    // EFFECTS:  fits the slot model of <this> LeafNode to its entries if the
+    //   <policy> searches by interpolation, otherwise drops it
+    void refitModel(const TreePolicy& policy);
+    
+    Room room;                                                  // entry storage in the slab cell, if any
+    std::vector<DataEntry, RoomAllocator<DataEntry>> entries;   // lent <room> while it fits
+    SlotModel model;
     LeafNode* leftNeighbor;
     LeafNode* rightNeighbor;
 };
 
+
+// the leaf step of every lookup, defined here where the traversals in
+// TreeNode.cpp can inline it
+
+// lower bound on the sorted entries, around the predicted slot if fit
+inline std::vector<DataEntry, RoomAllocator<DataEntry>>::const_iterator LeafNode::locate(const Key& key) const {
+    auto iter = model.search(entries.cbegin(), entries.cend(), key,
+                             [](const DataEntry& entry, const Key& k) { return Key(entry) < k; });
+    if (iter != entries.cend() && Key(*iter) == key) {
+        return iter;
+    }
+    return entries.cend();
+}
+
+// binary search the sorted entries; dead entries do not count
+inline bool LeafNode::contains(const Key& key) const {
+    auto iter = locate(key);
+    return (iter != entries.cend() && !iter->isDead());
+}
+
+// the entries live in their own allocation
+inline void LeafNode::prefetchContents() const {
+    prefetch(entries.data());
+}
+
+// a leaf always settles the lookup
+inline const TreeNode* LeafNode::stepToward(const Key& key, bool& found) const {
+    found = contains(key);
+    return nullptr;
+}
+
 #endif
@@ -0,0 +1,71 @@
+#include "LeafSlab.h"                                   // file-specific header
+#include <cassert>                                      // for assert
+#include <new>                                          // for operator new, operator delete
+#include <vector>                                       // for vector
+
+using std::vector;
+
+
+// constructor
+LeafSlab::LeafSlab(size_t count, size_t stride, char* first)
+    : inUse{ count }, count{ count }, stride{ stride }, first{ first } {}
+
+// round up to the next multiple of the strictest alignment
+size_t LeafSlab::aligned(size_t bytes) {
+    return (bytes + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+}
+
+// a lone cell still gets a header, so release can tell it apart
+void* LeafSlab::allocate(size_t bytes) {
+    static_assert(sizeof(Header) <= kHeaderBytes, "a cell header must fit in front of the cell");
+    
+    auto header = static_cast<char*>(::operator new(kHeaderBytes + bytes));
+    new (header) Header{ nullptr, 0 };
+    return header + kHeaderBytes;
+}
+
+// the bookkeeping goes in front of the cells, in the same allocation
+vector<void*> LeafSlab::allocateRun(size_t count, size_t bytes) {
+    assert(count >= 1);
+
+    size_t stride = kHeaderBytes + aligned(bytes);
+    auto block = static_cast<char*>(::operator new(aligned(sizeof(LeafSlab)) + count * stride));
+    auto slab = new (block) LeafSlab{ count, stride, block + aligned(sizeof(LeafSlab)) };
+
+    vector<void*> cells;
+    cells.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        char* header = slab->first + i * stride;
+        new (header) Header{ slab, i };
+        cells.push_back(header + kHeaderBytes);
+    }
+    return cells;
+}
+
+// whoever gives back the last cell of a slab frees it
+void LeafSlab::release(void* cell) {
+    auto header = reinterpret_cast<Header*>(static_cast<char*>(cell) - kHeaderBytes);
+    LeafSlab* slab = header->slab;
+    if (!slab) {
+        ::operator delete(header);
+        return;
+    }
+    if (slab->inUse.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        slab->~LeafSlab();
+        ::operator delete(slab);
+    }
+}
+
+// only the header of <cell> is read; the neighbor is found by address
+const void* LeafSlab::neighbor(const void* cell, long step) {
+    auto header = reinterpret_cast<const Header*>(static_cast<const char*>(cell) - kHeaderBytes);
+    const LeafSlab* slab = header->slab;
+    if (!slab) {
+        return nullptr;
+    }
+    long index = static_cast<long>(header->index) + step;
+    if (index < 0 || static_cast<size_t>(index) >= slab->count) {
+        return nullptr;
+    }
+    return slab->first + static_cast<size_t>(index) * slab->stride + kHeaderBytes;
+}
@@ -0,0 +1,74 @@
+#ifndef EECS484P3_LEAF_SLAB_H
+#define EECS484P3_LEAF_SLAB_H
+
+#include <atomic>                                       // for atomic
+#include <cstddef>                                      // for size_t, max_align_t
+#include <vector>                                       // for vector
+
+
+// Memory for leaves, either a cell at a time or a whole chain of cells laid
+// out back to back in one slab. Every cell is preceded by a header naming its
+// slab, so a leaf deleted anywhere gives its own cell back, and a slab is
+// freed along with its last cell. The leaves of one slab can end up in trees
+// run by different threads, so the count of cells in use is atomic.
+class LeafSlab {
+    public:
+        // [Lone Allocator]
+        // EFFECTS:  returns a newly allocated cell of <bytes> that belongs to
+        //   no slab
+        static void* allocate(size_t bytes);
+
+        // [Run Allocator]
+        // REQUIRES: <count> >= 1
+        // EFFECTS:  allocates one slab of <count> cells of <bytes> each, back to
+        //   back, and returns the cells in address order
+        static std::vector<void*> allocateRun(size_t count, size_t bytes);
+
+        // [Releaser]
+        // REQUIRES: <cell> came from an allocator above and was not released
+        // MODIFIES: memory pool
+        // EFFECTS:  gives <cell> back, freeing its slab with the last of its
+        //   cells
+        static void release(void* cell);
+
+        // [Neighbor Finder]
+        // REQUIRES: <cell> came from an allocator above and was not released
+        // EFFECTS:  returns the cell <step> places after <cell> in its slab
+        //   (before it if <step> is negative), in use or not, found by address
+        //   alone; returns nullptr if <cell> belongs to no slab or the slab
+        //   ends first
+        static const void* neighbor(const void* cell, long step);
+
+        // [Copy/Move Constructors and Assignment Operators]
+        // EFFECTS:  disables the copying or moving of LeafSlabs
+        LeafSlab(const LeafSlab& other) = delete;
+        LeafSlab(LeafSlab&& other) = delete;
+        LeafSlab& operator=(const LeafSlab& rhs) = delete;
+        LeafSlab& operator=(LeafSlab&& rhs) = delete;
+
+    private:
+        // what precedes every cell; <slab> is nullptr for a lone cell
+        struct Header {
+            LeafSlab* slab;
+            size_t index;                               // position of the cell in <slab>
+        };
+
+        // [Constructor]
+        // EFFECTS:  creates the bookkeeping of a slab of <count> cells in use,
+        //   <stride> bytes apart with the first at <first>
+        LeafSlab(size_t count, size_t stride, char* first);
+
+        // [Aligner]
+        // EFFECTS:  returns <bytes> rounded up to a multiple of the strictest
+        //   alignment
+        static size_t aligned(size_t bytes);
+
+        static const constexpr size_t kHeaderBytes = alignof(std::max_align_t);    // keeps cells aligned
+
+        std::atomic<size_t> inUse;                      // cells not yet released
+        size_t count;
+        size_t stride;                                  // bytes from one header to the next
+        char* first;                                    // header of the first cell
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "OutputBuffer.h"                               // file-specific header
+#include <cassert>                                      // for assert
+#include <charconv>                                     // for to_chars
+#include <cstring>                                      // for memcpy, memset, strlen
+#include <iostream>                                     // for ostream
+
+using std::ostream;
+using std::to_chars;
+
+static const constexpr size_t kMaxIntegerLength = 24;   // digits of a 64-bit value plus sign
+static const constexpr size_t kInitialSize = 256;       // bytes taken by the first append
+
+
+// constructor; nothing is allocated until the first append
+OutputBuffer::OutputBuffer(ostream& os, size_t capacity)
+    : os{ os }, buffer{}, capacity{ (capacity > kMaxIntegerLength) ? capacity : kMaxIntegerLength }, used{ 0 } {
+
+    assert(capacity > 0);
+}
+
+// destructor; anything not yet written goes out now
+OutputBuffer::~OutputBuffer() {
+    flush();
+}
+
+// copy raw text
+OutputBuffer& OutputBuffer::operator<<(const char* text) {
+    append(text, std::strlen(text));
+    return *this;
+}
+
+// copy single character
+OutputBuffer& OutputBuffer::operator<<(char c) {
+    *reserve(1) = c;
+    ++used;
+    return *this;
+}
+
+// format straight into the buffer, no temporary string
+OutputBuffer& OutputBuffer::operator<<(int value) {
+    char* first = reserve(kMaxIntegerLength);
+    used = static_cast<size_t>(to_chars(first, first + kMaxIntegerLength, value).ptr - buffer.data());
+    return *this;
+}
+
+// format straight into the buffer, no temporary string
+OutputBuffer& OutputBuffer::operator<<(size_t value) {
+    char* first = reserve(kMaxIntegerLength);
+    used = static_cast<size_t>(to_chars(first, first + kMaxIntegerLength, value).ptr - buffer.data());
+    return *this;
+}
+
+// fill with spaces in place
+void OutputBuffer::indent(int count) {
+    assert(count >= 0);
+
+    auto length = static_cast<size_t>(count);
+    while (length > 0) {
+        size_t chunk = (length < capacity) ? length : capacity;
+        std::memset(reserve(chunk), ' ', chunk);
+        used += chunk;
+        length -= chunk;
+    }
+}
+
+// hand everything to the stream in one write
+void OutputBuffer::flush() {
+    if (used > 0) {
+        os.write(buffer.data(), static_cast<std::streamsize>(used));
+        used = 0;
+    }
+}
+
+// flush only when the request would take the buffer past its cap, then
+// double until it fits, so short output costs a small allocation
+char* OutputBuffer::reserve(size_t length) {
+    assert(length <= capacity);
+
+    if (used + length > capacity) {
+        flush();
+    }
+    if (buffer.size() - used < length) {
+        size_t grown = (buffer.size() < kInitialSize) ? kInitialSize : buffer.size();
+        while (grown < used + length) {
+            grown *= 2;
+        }
+        buffer.resize((grown < capacity) ? grown : capacity);
+    }
+    return buffer.data() + used;
+}
+
+// copy in capacity-sized pieces so arbitrarily long text is fine
+void OutputBuffer::append(const char* data, size_t length) {
+    while (length > 0) {
+        size_t chunk = (length < capacity) ? length : capacity;
+        std::memcpy(reserve(chunk), data, chunk);
+        used += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef EECS484P3_OUTPUT_BUFFER_H
+#define EECS484P3_OUTPUT_BUFFER_H
+
+#include <cstddef>                                      // for size_t
+#include <iosfwd>                                       // for ostream forward declaration
+#include <vector>                                       // for vector
+
+
+class OutputBuffer {
+    public:
+        // [Constructor]
+        // REQUIRES: <capacity> > 0
+        // EFFECTS:  creates an empty buffer whose contents are written to <os>
+        //   whenever it fills up or is flushed; no memory is taken until
+        //   something is appended, and the buffer then grows as needed up to
+        //   <capacity> bytes
+        explicit OutputBuffer(std::ostream& os, size_t capacity = kDefaultCapacity);
+
+        // [Destructor]
+        // MODIFIES: the stream of <this> OutputBuffer
+        // EFFECTS:  flushes any buffered output
+        ~OutputBuffer();
+
+        // [Copy/Move Constructors and Assignment Operators]
+        // EFFECTS:  disables the copying or moving of OutputBuffers
+        OutputBuffer(const OutputBuffer& rhs) = delete;
+        OutputBuffer(OutputBuffer&& rhs) = delete;
+        OutputBuffer& operator=(const OutputBuffer& rhs) = delete;
+        OutputBuffer& operator=(OutputBuffer&& rhs) = delete;
+
+        // [Appenders]
+        // MODIFIES: <this>, the stream of <this> OutputBuffer if <this> fills up
+        // EFFECTS:  appends the text of <text>, the character <c>, or the
+        //   decimal representation of <value> to <this> OutputBuffer
+        OutputBuffer& operator<<(const char* text);
+        OutputBuffer& operator<<(char c);
+        OutputBuffer& operator<<(int value);
+        OutputBuffer& operator<<(size_t value);
+
+        // [Indenter]
+        // REQUIRES: <count> >= 0
+        // MODIFIES: <this>, the stream of <this> OutputBuffer if <this> fills up
+        // EFFECTS:  appends <count> spaces to <this> OutputBuffer
+        void indent(int count);
+
+        // [Flusher]
+        // MODIFIES: <this>, the stream of <this> OutputBuffer
+        // EFFECTS:  writes everything buffered so far to the stream with a
+        //   single write and empties <this> OutputBuffer
+        void flush();
+
+        static const constexpr size_t kDefaultCapacity = 1 << 20;
+
+    private:
+        // make room for at least <length> more bytes, growing or flushing if
+        // necessary, and return where they should be written
+        char* reserve(size_t length);
+        void append(const char* data, size_t length);
+
+        std::ostream& os;
+        std::vector<char> buffer;                       // grown geometrically up to <capacity>
+        size_t capacity;
+        size_t used;
+};
+
+#endif
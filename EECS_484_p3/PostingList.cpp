@@ -0,0 +1,195 @@
+#include "PostingList.h"                                // file-specific header
+#include "Utilities.h"                                  // for Record
+#include <algorithm>                                    // for copy, lower_bound
+#include <cassert>                                      // for assert
+#include <cstdint>                                      // for uint8_t, uint32_t
+#include <vector>                                       // for vector
+
+using std::vector;
+using std::uint8_t; using std::uint32_t;
+
+
+// fold the sign into the low bit so small negatives stay short
+static uint32_t zigzag(Record record) {
+    return (static_cast<uint32_t>(record) << 1) ^ static_cast<uint32_t>(record >> 31);
+}
+
+// inverse of zigzag
+static Record unzigzag(uint32_t value) {
+    return static_cast<Record>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+// seven bits per byte, high bit set on every byte but the last
+static void writeVarint(vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// read the varint at <position> and step past it
+static uint32_t readVarint(const vector<uint8_t>& in, size_t& position) {
+    uint32_t value = 0;
+    for (unsigned shift = 0; ; shift += 7) {
+        uint8_t byte = in[position++];
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+}
+
+
+// constructor
+PostingList::PostingList(const Record& first)
+    : inlined{}, encoded{}, last{ first }, count{ 1 } {
+
+    inlined[0] = first;
+}
+
+// appends in increasing order are the common case and never decode
+bool PostingList::insert(const Record& record) {
+    if (spilled()) {
+        if (record > last) {
+            appendGap(static_cast<uint32_t>(record) - static_cast<uint32_t>(last));
+            last = record;
+            ++count;
+            return true;
+        }
+        if (contains(record)) {
+            return false;
+        }
+        vector<Record> sorted;
+        appendTo(sorted);
+        sorted.insert(std::lower_bound(sorted.begin(), sorted.end(), record), record);
+        spill(sorted);
+        return true;
+    }
+
+    auto end = inlined.begin() + count;
+    auto iter = std::lower_bound(inlined.begin(), end, record);
+    if (iter != end && *iter == record) {
+        return false;
+    }
+    if (count < kInlineCapacity) {
+        std::copy_backward(iter, end, end + 1);
+        *iter = record;
+        ++count;
+        return true;
+    }
+
+    vector<Record> sorted{ inlined.begin(), iter };
+    sorted.push_back(record);
+    sorted.insert(sorted.end(), iter, end);
+    spill(sorted);
+    return true;
+}
+
+// a spilled list that shrinks back to inline size moves back inline
+bool PostingList::erase(const Record& record) {
+    if (!spilled()) {
+        auto end = inlined.begin() + count;
+        auto iter = std::lower_bound(inlined.begin(), end, record);
+        if (iter == end || *iter != record) {
+            return false;
+        }
+        std::copy(iter + 1, end, iter);
+        --count;
+        return true;
+    }
+
+    vector<Record> sorted;
+    appendTo(sorted);
+    auto iter = std::lower_bound(sorted.begin(), sorted.end(), record);
+    if (iter == sorted.end() || *iter != record) {
+        return false;
+    }
+    sorted.erase(iter);
+
+    if (sorted.size() > kInlineCapacity) {
+        spill(sorted);
+    }
+    else {
+        std::copy(sorted.cbegin(), sorted.cend(), inlined.begin());
+        count = sorted.size();
+        encoded = vector<uint8_t>{};
+    }
+    return true;
+}
+
+// decode only as far as <record> could be
+bool PostingList::contains(const Record& record) const {
+    if (!spilled()) {
+        auto end = inlined.cbegin() + count;
+        auto iter = std::lower_bound(inlined.cbegin(), end, record);
+        return iter != end && *iter == record;
+    }
+    if (record > last) {
+        return false;
+    }
+
+    size_t position = 0;
+    Record current = unzigzag(readVarint(encoded, position));
+    while (current < record && position < encoded.size()) {
+        current = static_cast<Record>(static_cast<uint32_t>(current) + readVarint(encoded, position));
+    }
+    return current == record;
+}
+
+// return number of records
+size_t PostingList::size() const {
+    return count;
+}
+
+// return whether no records are left
+bool PostingList::empty() const {
+    return count == 0;
+}
+
+// decode in order
+void PostingList::appendTo(vector<Record>& out) const {
+    if (!spilled()) {
+        out.insert(out.end(), inlined.cbegin(), inlined.cbegin() + count);
+        return;
+    }
+
+    out.reserve(out.size() + count);
+    size_t position = 0;
+    Record current = unzigzag(readVarint(encoded, position));
+    out.push_back(current);
+    while (position < encoded.size()) {
+        current = static_cast<Record>(static_cast<uint32_t>(current) + readVarint(encoded, position));
+        out.push_back(current);
+    }
+}
+
+// inline records live in the object; only the encoded block is extra
+size_t PostingList::footprint() const {
+    return encoded.capacity();
+}
+
+// only spilled lists have encoded bytes
+bool PostingList::spilled() const {
+    return !encoded.empty();
+}
+
+// re-encode <sorted> from scratch
+void PostingList::spill(const vector<Record>& sorted) {
+    assert(sorted.size() > kInlineCapacity);
+
+    encoded.clear();
+    writeVarint(encoded, zigzag(sorted.front()));
+    for (size_t i = 1; i < sorted.size(); ++i) {
+        appendGap(static_cast<uint32_t>(sorted[i]) - static_cast<uint32_t>(sorted[i - 1]));
+    }
+    last = sorted.back();
+    count = sorted.size();
+}
+
+// gaps between distinct increasing records are never zero
+void PostingList::appendGap(uint32_t gap) {
+    assert(gap > 0);
+
+    writeVarint(encoded, gap);
+}
@@ -0,0 +1,62 @@
+#ifndef EECS484P3_POSTING_LIST_H
+#define EECS484P3_POSTING_LIST_H
+
+#include "Utilities.h"                                  // for Record
+#include <array>                                        // for array
+#include <cstdint>                                      // for uint8_t, uint32_t
+#include <vector>                                       // for vector
+
+
+class PostingList {
+    public:
+        // [Constructor]
+        // EFFECTS:  creates a posting list holding only <first>
+        explicit PostingList(const Record& first);
+
+        // [Inserter/Eraser]
+        // MODIFIES: <this>
+        // EFFECTS:  adds <record> to, or removes <record> from, <this>
+        //   PostingList; returns TRUE if and only if <this> PostingList
+        //   changed
+        bool insert(const Record& record);
+        bool erase(const Record& record);
+
+        // [Containment Checker]
+        // EFFECTS:  returns TRUE if and only if <this> PostingList holds
+        //   <record>
+        bool contains(const Record& record) const;
+
+        // [Statistic Accessors]
+        // EFFECTS:  returns the number of records in <this> PostingList, or
+        //   TRUE if and only if it holds none
+        size_t size() const;
+        bool empty() const;
+
+        // [Record Lister]
+        // MODIFIES: <out>
+        // EFFECTS:  appends every record in <this> PostingList to <out> in
+        //   increasing order
+        void appendTo(std::vector<Record>& out) const;
+
+        // [Footprint Accessor]
+        // EFFECTS:  returns the heap bytes held by <this> PostingList beyond
+        //   the object itself
+        size_t footprint() const;
+
+    private:
+        // up to kInlineCapacity records are kept sorted in <inlined>; past
+        // that they spill to <encoded>: the first record zigzag-encoded, then
+        // the gap to each next record, all as little-endian base-128 varints
+        static const constexpr size_t kInlineCapacity = 4;
+
+        bool spilled() const;
+        void spill(const std::vector<Record>& sorted);
+        void appendGap(std::uint32_t gap);
+
+        std::array<Record, kInlineCapacity> inlined;
+        std::vector<std::uint8_t> encoded;
+        Record last;                                    // largest record once spilled, for cheap appends
+        size_t count;
+};
+
+#endif
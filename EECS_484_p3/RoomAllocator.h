@@ -0,0 +1,91 @@
+#ifndef EECS484P3_ROOM_ALLOCATOR_H
+#define EECS484P3_ROOM_ALLOCATOR_H
+
+#include <cstddef>                                      // for size_t
+#include <memory>                                       // for allocator
+#include <type_traits>                                  // for false_type
+
+
+// storage set aside ahead of time for one container, such as the entries of
+// a leaf built into a LeafSlab; it is lent to one allocation at a time
+struct Room {
+    void* storage = nullptr;                            // nullptr if nothing is set aside
+    size_t bytes = 0;
+    bool lent = false;                                  // TRUE while an allocation holds <storage>
+};
+
+
+// Allocator that lends out its Room whenever the room is free and big
+// enough, and uses the heap otherwise, so a container that outgrows its room
+// simply moves to the heap. A copy of a container starts without a room, and
+// containers keep their own allocator on move assignment, so a room is only
+// ever used by the container it was set aside for.
+template <typename T>
+class RoomAllocator {
+    public:
+        using value_type = T;
+        using propagate_on_container_move_assignment = std::false_type;
+        using propagate_on_container_swap = std::false_type;
+
+        // [Constructors]
+        // REQUIRES: <room> outlives every allocation made from it
+        // EFFECTS:  creates an allocator lending out <room>, or only using the
+        //   heap if <room> is nullptr; a rebound copy lends out the same room
+        explicit RoomAllocator(Room* room = nullptr) : room{ room } {}
+        template <typename U>
+        RoomAllocator(const RoomAllocator<U>& other) : room{ other.room } {}
+
+        // [Copy Selector]
+        // EFFECTS:  returns the allocator a copy of a container starts with,
+        //   which has no room
+        RoomAllocator select_on_container_copy_construction() const {
+            return RoomAllocator{};
+        }
+
+        // [Allocator/Deallocator]
+        // EFFECTS:  returns storage for <count> objects, the room if it is
+        //   free and big enough; gives back <storage> for <count> objects
+        T* allocate(size_t count);
+        void deallocate(T* storage, size_t count);
+
+        // [Comparison Operators]
+        // EFFECTS:  returns TRUE if and only if both lend out the same room
+        //   (or different ones)
+        template <typename U>
+        bool operator==(const RoomAllocator<U>& rhs) const {
+            return room == rhs.room;
+        }
+        template <typename U>
+        bool operator!=(const RoomAllocator<U>& rhs) const {
+            return room != rhs.room;
+        }
+
+    private:
+        template <typename U>
+        friend class RoomAllocator;
+
+        Room* room;
+};
+
+
+// the room goes out first; everything else comes from the heap
+template <typename T>
+T* RoomAllocator<T>::allocate(size_t count) {
+    if (room && room->storage && !room->lent && count * sizeof(T) <= room->bytes) {
+        room->lent = true;
+        return static_cast<T*>(room->storage);
+    }
+    return std::allocator<T>{}.allocate(count);
+}
+
+// the room stays with its owner, ready to be lent again
+template <typename T>
+void RoomAllocator<T>::deallocate(T* storage, size_t count) {
+    if (room && storage == room->storage) {
+        room->lent = false;
+        return;
+    }
+    std::allocator<T>{}.deallocate(storage, count);
+}
+
+#endif
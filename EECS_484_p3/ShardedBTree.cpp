@@ -0,0 +1,278 @@
+#include "ShardedBTree.h"                               // file-specific header
+#include "BTree.h"                                      // for BTree, PageToken
+#include "DataEntry.h"                                  // for DataEntry
+#include "TaskQueue.h"                                  // for TaskQueue
+#include "Utilities.h"                                  // for Key, Record aliases
+#include <algorithm>                                    // for upper_bound, is_sorted, adjacent_find
+#include <cassert>                                      // for assert
+#include <cstdint>                                      // for int64_t
+#include <exception>                                    // for current_exception
+#include <functional>                                   // for function, greater_equal
+#include <future>                                       // for future, promise, shared_future
+#include <limits>                                       // for numeric_limits
+#include <memory>                                       // for unique_ptr, shared_ptr, make_shared
+#include <mutex>                                        // for mutex, lock_guard, unique_lock
+#include <shared_mutex>                                 // for shared_mutex, shared_lock
+#include <string>                                       // for string, to_string
+#include <utility>                                      // for move
+#include <vector>                                       // for vector
+
+using std::vector;
+using std::string; using std::to_string;
+using std::numeric_limits;
+using std::function;
+using std::future; using std::promise; using std::shared_future;
+using std::mutex; using std::lock_guard;
+using std::unique_ptr; using std::make_shared;
+using std::shared_mutex; using std::shared_lock; using std::unique_lock;
+using std::int64_t;
+
+
+// cut the whole key space into <shards> ranges of equal width
+static vector<Key> evenSplitKeys(size_t shards) {
+    assert(shards >= 1);
+
+    int64_t low = numeric_limits<Key>::min();
+    int64_t width = (static_cast<int64_t>(numeric_limits<Key>::max()) - low + 1) / static_cast<int64_t>(shards);
+    vector<Key> splitKeys;
+    for (size_t i = 1; i < shards; ++i) {
+        splitKeys.push_back(static_cast<Key>(low + width * static_cast<int64_t>(i)));
+    }
+    return splitKeys;
+}
+
+
+// shard constructor; the worker runs tasks until one of them stops it
+ShardedBTree::Shard::Shard(BTree&& initial)
+    : tree{ std::move(initial) }, queue{}, running{ true }, load{ 0 },
+      worker{ [this]{ while (running) { queue.pop()(); } } } {}
+
+// shard destructor; the stop task queues behind everything already pushed
+ShardedBTree::Shard::~Shard() {
+    queue.push([this]{ running = false; });
+    worker.join();
+}
+
+// constructor for equal-width ranges
+ShardedBTree::ShardedBTree(size_t shards)
+    : ShardedBTree{ evenSplitKeys(shards) } {}
+
+// constructor for chosen ranges
+ShardedBTree::ShardedBTree(const vector<Key>& splitKeys)
+    : shards{}, lowerBounds{ numeric_limits<Key>::min() }, routing{}, splitting{} {
+
+    assert(std::adjacent_find(splitKeys.cbegin(), splitKeys.cend(), std::greater_equal<Key>{}) == splitKeys.cend());
+    assert(splitKeys.empty() || splitKeys.front() > numeric_limits<Key>::min());
+
+    lowerBounds.insert(lowerBounds.end(), splitKeys.cbegin(), splitKeys.cend());
+    for (size_t i = 0; i < lowerBounds.size(); ++i) {
+        shards.emplace_back(new Shard{ BTree{} });
+    }
+}
+
+// destructor; each shard drains and stops as it is destroyed
+ShardedBTree::~ShardedBTree() {}
+
+// return number of shards
+size_t ShardedBTree::getShards() const {
+    shared_lock<shared_mutex> guard{ routing };
+    return shards.size();
+}
+
+// ask every shard at once, then add up the answers
+size_t ShardedBTree::getSize() const {
+    shared_lock<shared_mutex> guard{ routing };
+    vector<future<size_t>> sizes;
+    for (auto& shard : shards) {
+        sizes.push_back(request<size_t>(*shard, [](BTree& tree){ return tree.getSize(); }));
+    }
+
+    size_t total = 0;
+    for (auto& size : sizes) {
+        total += size.get();
+    }
+    return total;
+}
+
+// fire and forget
+void ShardedBTree::insertEntry(const DataEntry& newEntry) {
+    shared_lock<shared_mutex> guard{ routing };
+    Shard& shard = *shards[shardFor(newEntry)];
+    shard.load.fetch_add(1, std::memory_order_relaxed);
+    shard.queue.push([&shard, newEntry]{ shard.tree.insertEntry(newEntry); });
+}
+
+// fire and forget
+void ShardedBTree::deleteEntry(const DataEntry& entryToRemove) {
+    shared_lock<shared_mutex> guard{ routing };
+    Shard& shard = *shards[shardFor(entryToRemove)];
+    shard.load.fetch_add(1, std::memory_order_relaxed);
+    shard.queue.push([&shard, entryToRemove]{ shard.tree.deleteEntry(entryToRemove); });
+}
+
+// fire and forget
+void ShardedBTree::upsert(const Key& key, const Record& record) {
+    shared_lock<shared_mutex> guard{ routing };
+    Shard& shard = *shards[shardFor(key)];
+    shard.load.fetch_add(1, std::memory_order_relaxed);
+    shard.queue.push([&shard, key, record]{ shard.tree.upsert(key, record); });
+}
+
+// the answer waits behind everything already queued on the shard
+bool ShardedBTree::contains(const Key& key) const {
+    shared_lock<shared_mutex> guard{ routing };
+    Shard& shard = *shards[shardFor(key)];
+    shard.load.fetch_add(1, std::memory_order_relaxed);
+    return request<bool>(shard, [key](BTree& tree){ return tree.contains(key); }).get();
+}
+
+// the overlapping shards scan in parallel; their results are already in
+// order relative to each other
+vector<DataEntry> ShardedBTree::rangeFind(const Key& begin, const Key& end) const {
+    assert(end >= begin);
+
+    shared_lock<shared_mutex> guard{ routing };
+    vector<future<vector<DataEntry>>> parts;
+    for (size_t i = shardFor(begin); i <= shardFor(end); ++i) {
+        shards[i]->load.fetch_add(1, std::memory_order_relaxed);
+        parts.push_back(request<vector<DataEntry>>(*shards[i], [begin, end](BTree& tree){
+            return tree.rangeFind(begin, end);
+        }));
+    }
+
+    vector<DataEntry> results = parts.front().get();
+    for (size_t i = 1; i < parts.size(); ++i) {
+        auto part = parts[i].get();
+        results.insert(results.end(), part.cbegin(), part.cend());
+    }
+    return results;
+}
+
+// a no-op request on every shard drains whatever was queued before it
+void ShardedBTree::sync() const {
+    shared_lock<shared_mutex> guard{ routing };
+    vector<future<bool>> drained;
+    for (auto& shard : shards) {
+        drained.push_back(request<bool>(*shard, [](BTree&){ return true; }));
+    }
+    for (auto& done : drained) {
+        done.wait();
+    }
+}
+
+// the median is found by an offset seek under the shared lock; the split
+// itself is queued on the hot shard in the same exclusive section that
+// routes the upper keys to the new shard, so it runs behind everything
+// routed to the hot shard before, and the gate queued first on the new
+// shard holds back everything routed there after until the upper half
+// arrives
+bool ShardedBTree::splitHotShard() {
+    lock_guard<mutex> serial{ splitting };
+    size_t hottest = 0;
+    Key median{};
+    {
+        shared_lock<shared_mutex> guard{ routing };
+        size_t hottestLoad = 0;
+        for (size_t i = 0; i < shards.size(); ++i) {
+            size_t load = shards[i]->load.exchange(0, std::memory_order_relaxed);
+            if (load > hottestLoad) {
+                hottest = i;
+                hottestLoad = load;
+            }
+        }
+        
+        bool found = request<bool>(*shards[hottest], [&median](BTree& tree){
+            size_t live = tree.getSize();
+            if (live < 2) {
+                return false;
+            }
+            PageToken token{};
+            auto page = tree.rangeFindAt(numeric_limits<Key>::min(), numeric_limits<Key>::max(),
+                                         live / 2, 1, token);
+            if (page.empty()) {
+                return false;
+            }
+            median = page.front();
+            return true;
+        }).get();
+        if (!found) {
+            return false;
+        }
+    }
+
+    unique_ptr<Shard> added{ new Shard{ BTree{} } };
+    future<bool> gate;
+    {
+        unique_lock<shared_mutex> guard{ routing };
+        auto upper = request<unique_ptr<BTree>>(*shards[hottest], [median](BTree& tree){
+            return unique_ptr<BTree>{ new BTree{ tree.splitAt(median) } };
+        }).share();
+        gate = request<bool>(*added, [upper](BTree& tree){
+            tree = std::move(*upper.get());
+            return true;
+        });
+        shards.insert(shards.begin() + static_cast<long>(hottest) + 1, std::move(added));
+        lowerBounds.insert(lowerBounds.begin() + static_cast<long>(hottest) + 1, median);
+    }
+    return gate.get();
+}
+
+// check each tree and that its live keys stay inside its range
+bool ShardedBTree::verify(string* failure) const {
+    shared_lock<shared_mutex> guard{ routing };
+    vector<future<string>> reports;
+    for (size_t i = 0; i < shards.size(); ++i) {
+        Key low = lowerBounds[i];
+        bool last = (i + 1 == shards.size());
+        Key high = last ? numeric_limits<Key>::max() : lowerBounds[i + 1];
+        reports.push_back(request<string>(*shards[i], [low, high, last](BTree& tree){
+            string problem;
+            if (!tree.verify(&problem)) {
+                return problem;
+            }
+            if (low > numeric_limits<Key>::min() && !tree.rangeFind(numeric_limits<Key>::min(), low - 1).empty()) {
+                return "holds keys below " + to_string(low);
+            }
+            if (!last && !tree.rangeFind(high, numeric_limits<Key>::max()).empty()) {
+                return "holds keys from " + to_string(high) + " on";
+            }
+            return string{};
+        }));
+    }
+
+    string found;
+    for (size_t i = 0; i < reports.size(); ++i) {
+        string problem = reports[i].get();
+        if (found.empty() && !problem.empty()) {
+            found = "shard " + to_string(i) + " " + problem;
+        }
+    }
+    if (failure) {
+        *failure = found;
+    }
+    return found.empty();
+}
+
+// the last shard whose lower bound is not past <key>
+size_t ShardedBTree::shardFor(const Key& key) const {
+    auto after = std::upper_bound(lowerBounds.cbegin(), lowerBounds.cend(), key);
+    return static_cast<size_t>(after - lowerBounds.cbegin()) - 1;
+}
+
+// the promise is shared so the task stays copyable, as TaskQueue needs;
+// whatever <query> throws is handed to the waiting thread instead of
+// ending the worker
+template <typename Result>
+future<Result> ShardedBTree::request(Shard& shard, function<Result(BTree&)> query) const {
+    auto answer = make_shared<promise<Result>>();
+    auto result = answer->get_future();
+    shard.queue.push([&shard, answer, query]{
+        try {
+            answer->set_value(query(shard.tree));
+        }
+        catch (...) {
+            answer->set_exception(std::current_exception());
+        }
+    });
+    return result;
+}
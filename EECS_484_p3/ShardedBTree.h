@@ -0,0 +1,133 @@
+#ifndef EECS484P3_SHARDED_BTREE_H
+#define EECS484P3_SHARDED_BTREE_H
+
+#include "BTree.h"                                      // for BTree, Upsert
+#include "TaskQueue.h"                                  // for TaskQueue
+#include "Utilities.h"                                  // for Key, Record aliases
+#include <atomic>                                       // for atomic
+#include <functional>                                   // for function
+#include <future>                                       // for future
+#include <memory>                                       // for unique_ptr
+#include <mutex>                                        // for mutex
+#include <shared_mutex>                                 // for shared_mutex
+#include <string>                                       // for string
+#include <thread>                                       // for thread
+#include <vector>                                       // for vector
+
+class DataEntry;                                        // only used as function argument
+
+
+// Front end that range-partitions the key space across independent BTrees,
+// each owned by a worker thread that applies the operations routed to it in
+// the order they arrive on its TaskQueue.
+class ShardedBTree {
+    public:
+        // [Constructors]
+        // REQUIRES: <shards> >= 1; <splitKeys> is strictly increasing
+        // EFFECTS:  creates an empty ShardedBTree whose key space is cut into
+        //   <shards> ranges of equal width, or cut just before every key of
+        //   <splitKeys>, and starts one worker thread per range
+        explicit ShardedBTree(size_t shards);
+        explicit ShardedBTree(const std::vector<Key>& splitKeys);
+
+        // [Destructor]
+        // MODIFIES: memory pool
+        // EFFECTS:  lets every worker finish the operations already queued for
+        //   it, then stops it and deallocates its BTree
+        ~ShardedBTree();
+
+        // [Copy/Move Constructors and Assignment Operators]
+        // EFFECTS:  disables the copying or moving of ShardedBTrees
+        ShardedBTree(const ShardedBTree& other) = delete;
+        ShardedBTree(ShardedBTree&& other) = delete;
+        ShardedBTree& operator=(const ShardedBTree& rhs) = delete;
+        ShardedBTree& operator=(ShardedBTree&& rhs) = delete;
+
+        // [Statistic Accessors]
+        // EFFECTS:  returns the number of shards, or the number of data
+        //   entries across all of them once the operations queued so far
+        //   have been applied
+        size_t getShards() const;
+        size_t getSize() const;
+
+        // [Inserter/Deleter/Upserter]
+        // MODIFIES: <this>
+        // EFFECTS:  queues the insert, delete or upsert on the shard whose
+        //   range holds the key and returns without waiting for it; the
+        //   operations one thread queues on a key are applied in order, and
+        //   before any later lookup that thread makes
+        void insertEntry(const DataEntry& newEntry);
+        void deleteEntry(const DataEntry& entryToRemove);
+        void upsert(const Key& key, const Record& record);
+
+        // [Containment Checker]
+        // EFFECTS:  returns TRUE if and only if the shard whose range holds
+        //   <key> holds a live data entry whose key is <key>
+        bool contains(const Key& key) const;
+
+        // [Range Value Finder]
+        // REQUIRES: <end> >= <begin>
+        // EFFECTS:  returns a sorted list of all data entries whose key is in
+        //   the range [<begin>, <end>] (both endpoints inclusive): every shard
+        //   overlapping the range scans its part at once, and since the shards
+        //   hold disjoint ascending ranges their results are merged in order
+        //   by appending them shard by shard
+        std::vector<DataEntry> rangeFind(const Key& begin, const Key& end) const;
+
+        // [Synchronizer]
+        // EFFECTS:  returns once every operation queued before the call has
+        //   been applied
+        void sync() const;
+
+        // [Hot Shard Splitter]
+        // MODIFIES: <this>
+        // EFFECTS:  splits the shard that was routed the most operations since
+        //   the previous call at its median live key, handing the upper half
+        //   to a new worker thread, and returns TRUE; returns FALSE and leaves
+        //   the shards alone if that shard holds fewer than two live entries;
+        //   operations queued before the split are applied before it, those
+        //   routed to the new shard after it wait on that shard until the
+        //   upper half arrives, and routing waits only while the new shard
+        //   is inserted, never on the seek or the split themselves
+        bool splitHotShard();
+
+        // [Verifier]
+        // MODIFIES: <failure> if it is not nullptr
+        // EFFECTS:  returns TRUE if and only if the BTree of every shard
+        //   verifies and holds no live key outside the range of that shard;
+        //   on failure, describes the first violation found in <failure>
+        bool verify(std::string* failure = nullptr) const;
+
+    private:
+        // a BTree, the worker thread that alone touches it and the queue that
+        // feeds the worker; the worker starts with the Shard and stops with it
+        struct Shard {
+            explicit Shard(BTree&& initial);
+            ~Shard();
+
+            BTree tree;
+            TaskQueue queue;
+            bool running;                               // read and cleared only by <worker>
+            std::atomic<size_t> load;                   // operations routed here since the last split check
+            std::thread worker;
+        };
+
+        // [Shard Router]
+        // REQUIRES: the caller holds <routing>
+        // EFFECTS:  returns the index of the shard whose range holds <key>
+        size_t shardFor(const Key& key) const;
+
+        // [Shard Requester]
+        // MODIFIES: the BTree of <shard> if <query> does
+        // EFFECTS:  queues <query> on <shard> and returns a future that
+        //   becomes ready with its result once the worker has run it
+        template <typename Result>
+        std::future<Result> request(Shard& shard, std::function<Result(BTree&)> query) const;
+
+        std::vector<std::unique_ptr<Shard>> shards;     // in key order
+        std::vector<Key> lowerBounds;                   // smallest key routed to each shard
+        mutable std::shared_mutex routing;              // shared to route, exclusive to change the shards
+        std::mutex splitting;                           // held for a whole split, so splits run one at a time
+};
+
+#endif
@@ -0,0 +1,31 @@
+#include "SlotModel.h"                                  // file-specific header
+#include "Utilities.h"                                  // for Key alias
+#include <algorithm>                                    // for min
+
+static const constexpr size_t kDriftSlack = 4;          // slots keys may shift between fits before a search falls back
+
+
+// constructor
+SlotModel::SlotModel()
+    : lowest{ 0 }, scale{ 0 }, error{ 0 }, fitCount{ 0 } {}
+
+// forget the line
+void SlotModel::clear() {
+    fitCount = 0;
+}
+
+// clamp the guess into the node, then pad it on both sides
+void SlotModel::window(const Key& key, size_t count, size_t& low, size_t& high) const {
+    double guess = (static_cast<double>(key) - lowest) * scale * static_cast<double>(count - 1);
+    size_t slot = 0;
+    if (guess >= static_cast<double>(count)) {
+        slot = count;
+    }
+    else if (guess > 0) {
+        slot = static_cast<size_t>(guess);
+    }
+
+    size_t width = (error * count + fitCount - 1) / fitCount + kDriftSlack;
+    low = (slot > width) ? slot - width : 0;
+    high = std::min(count, slot + width + 1);
+}
@@ -0,0 +1,118 @@
+#ifndef EECS484P3_SLOT_MODEL_H
+#define EECS484P3_SLOT_MODEL_H
+
+#include "Utilities.h"                                  // for Key alias
+#include <algorithm>                                    // for max, partition_point
+#include <cstddef>                                      // for size_t, ptrdiff_t
+
+
+// Tiny linear model of where a key sits in the sorted keys of one node,
+// fit when the node is split or bulk-loaded. It predicts a fraction of the
+// way through the node rather than a slot, so it keeps up with a node that
+// fills evenly after the fit. A search probes only a small
+// window around the predicted slot, confirms from its two edges that the
+// answer cannot lie outside it, and otherwise falls back to a binary search
+// of the whole node, so a model that went stale only costs time. Nodes whose
+// keys are too skewed for a line to predict never get a model.
+class SlotModel {
+    public:
+        // [Constructor]
+        // EFFECTS:  creates an unfit model, which leaves every search binary
+        SlotModel();
+
+        // [Fitter]
+        // REQUIRES: the keys of [<first>, <last>) are sorted
+        // MODIFIES: <this>
+        // EFFECTS:  fits the line through the first and last keys of
+        //   [<first>, <last>) and keeps it only if no key is predicted more
+        //   than a few slots from where it is
+        template <typename Iter>
+        void fit(Iter first, Iter last);
+
+        // [Clearer]
+        // MODIFIES: <this>
+        // EFFECTS:  drops the model, so searches are binary again
+        void clear();
+
+        // [Searcher]
+        // REQUIRES: [<first>, <last>) is partitioned by <before>(element,
+        //   <key>): every element for which it is TRUE comes first
+        // EFFECTS:  returns the first element of [<first>, <last>) for which
+        //   <before>(element, <key>) is FALSE, as std::partition_point would
+        template <typename Iter, typename Before>
+        Iter search(Iter first, Iter last, const Key& key, Before before) const;
+
+    private:
+        // [Window Finder]
+        // REQUIRES: <this> SlotModel is fit
+        // MODIFIES: <low>, <high>
+        // EFFECTS:  sets [<low>, <high>) to the slots around where <key> is
+        //   predicted among <count> keys, widened by the fit error, scaled to
+        //   <count>, plus some slack for uneven changes since the fit
+        void window(const Key& key, size_t count, size_t& low, size_t& high) const;
+
+        static const constexpr size_t kMinimumKeys = 8;         // smaller nodes are searched as fast without
+        static const constexpr size_t kMaximumError = 8;        // worst misprediction a kept model may make
+
+        double lowest;                                  // first key at fit time
+        double scale;                                   // fraction of the node per unit of key
+        size_t error;                                   // worst misprediction at fit time
+        size_t fitCount;                                // keys at fit time, 0 if unfit
+};
+
+
+// fit through the end points, then measure the worst miss
+template <typename Iter>
+void SlotModel::fit(Iter first, Iter last) {
+    clear();
+    size_t count = static_cast<size_t>(last - first);
+    if (count < kMinimumKeys) {
+        return;
+    }
+    double low = static_cast<double>(Key(*first));
+    double high = static_cast<double>(Key(*(last - 1)));
+    if (high == low) {
+        return;
+    }
+
+    double newScale = 1 / (high - low);
+    double slots = static_cast<double>(count - 1);
+    size_t worst = 0;
+    for (size_t i = 0; i < count; ++i) {
+        double guess = (static_cast<double>(Key(first[static_cast<std::ptrdiff_t>(i)])) - low) * newScale * slots;
+        double miss = (guess > static_cast<double>(i)) ? guess - static_cast<double>(i) : static_cast<double>(i) - guess;
+        if (miss > static_cast<double>(kMaximumError)) {
+            return;
+        }
+        worst = std::max(worst, static_cast<size_t>(miss) + 1);
+    }
+
+    lowest = low;
+    scale = newScale;
+    error = worst;
+    fitCount = count;
+}
+
+// the window is trusted only if the elements just outside it agree
+template <typename Iter, typename Before>
+Iter SlotModel::search(Iter first, Iter last, const Key& key, Before before) const {
+    auto goesBefore = [&key, &before](const auto& element) { return before(element, key); };
+    size_t count = static_cast<size_t>(last - first);
+    if (!fitCount || count == 0) {
+        return std::partition_point(first, last, goesBefore);
+    }
+
+    size_t low = 0;
+    size_t high = 0;
+    window(key, count, low, high);
+    auto windowEnd = first + static_cast<std::ptrdiff_t>(high);
+    auto found = std::partition_point(first + static_cast<std::ptrdiff_t>(low), windowEnd, goesBefore);
+    bool settledLow = (low == 0 || goesBefore(first[static_cast<std::ptrdiff_t>(low) - 1]));
+    bool settledHigh = (found != windowEnd || high == count || !goesBefore(*windowEnd));
+    if (settledLow && settledHigh) {
+        return found;
+    }
+    return std::partition_point(first, last, goesBefore);
+}
+
+#endif
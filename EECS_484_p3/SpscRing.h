@@ -0,0 +1,161 @@
+#ifndef EECS484P3_SPSC_RING_H
+#define EECS484P3_SPSC_RING_H
+
+#include <atomic>                                       // for atomic, memory_order
+#include <condition_variable>                           // for condition_variable
+#include <cstddef>                                      // for size_t
+#include <mutex>                                        // for mutex, lock_guard, unique_lock
+#include <thread>                                       // for yield
+#include <utility>                                      // for move
+#include <vector>                                       // for vector
+
+
+// Bounded queue between exactly one producer thread and one consumer thread,
+// kept in a ring of slots. Each side owns one index and only reads the
+// other's, so neither pushing nor popping locks while there is room and
+// something to take. A side that finds the ring full (or empty) spins
+// briefly and then sleeps until the other side moves or the ring is closed;
+// the lock is taken only to sleep and to wake a sleeper.
+template <typename T>
+class SpscRing {
+    public:
+        // [Constructor]
+        // REQUIRES: <capacity> > 0
+        // EFFECTS:  creates an empty, open ring holding at least <capacity>
+        //   items, rounded up to a power of two
+        explicit SpscRing(size_t capacity);
+
+        // [Copy/Move Constructors and Assignment Operators]
+        // EFFECTS:  disables the copying or moving of SpscRings
+        SpscRing(const SpscRing& other) = delete;
+        SpscRing(SpscRing&& other) = delete;
+        SpscRing& operator=(const SpscRing& rhs) = delete;
+        SpscRing& operator=(SpscRing&& rhs) = delete;
+
+        // [Pusher]
+        // REQUIRES: only one thread ever pushes onto <this> SpscRing
+        // MODIFIES: <this>
+        // EFFECTS:  appends <item> to <this> SpscRing, waiting while it is
+        //   full, and returns TRUE; returns FALSE without appending if <this>
+        //   SpscRing is closed
+        bool push(T item);
+
+        // [Popper]
+        // REQUIRES: only one thread ever pops from <this> SpscRing
+        // MODIFIES: <this>, <item>
+        // EFFECTS:  moves the oldest item of <this> SpscRing into <item>,
+        //   waiting while it is empty, and returns TRUE; returns FALSE once
+        //   <this> SpscRing is closed and every item pushed before that has
+        //   been popped
+        bool pop(T& item);
+
+        // [Closer]
+        // MODIFIES: <this>
+        // EFFECTS:  closes <this> SpscRing, so later pushes fail and pops
+        //   fail once it drains, and wakes either side if it is asleep; safe
+        //   to call from either side
+        void close();
+
+    private:
+        static const constexpr int kSpinsBeforeSleep = 64;     // full or empty polls before a side sleeps
+
+        // [Waker]
+        // EFFECTS:  wakes the other side if it went to sleep
+        void wake(const std::atomic<bool>& sleeping);
+
+        std::vector<T> slots;
+        size_t mask;                                    // slots.size() - 1
+        std::atomic<size_t> head;                       // items popped so far, moved by the consumer
+        std::atomic<size_t> tail;                       // items pushed so far, moved by the producer
+        std::atomic<bool> closed;
+        std::atomic<bool> producerSleeping;             // TRUE while the producer waits on <wakeup>
+        std::atomic<bool> consumerSleeping;             // TRUE while the consumer waits on <wakeup>
+        std::mutex sleepLock;
+        std::condition_variable wakeup;
+};
+
+
+// constructor; both indices only ever grow and are masked into a slot
+template <typename T>
+SpscRing<T>::SpscRing(size_t capacity)
+    : slots{}, mask{ 0 }, head{ 0 }, tail{ 0 }, closed{ false },
+      producerSleeping{ false }, consumerSleeping{ false }, sleepLock{}, wakeup{} {
+
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    slots.resize(size);
+    mask = size - 1;
+}
+
+// the item is in its slot before the tail moves past it; the sleeping
+// check comes after that move, so a consumer that slept too early is
+// always woken
+template <typename T>
+bool SpscRing<T>::push(T item) {
+    size_t position = tail.load(std::memory_order_relaxed);
+    auto hasRoom = [&]{ return closed.load() || position - head.load() < slots.size(); };
+    for (int spin = 0; !hasRoom(); ++spin) {
+        if (spin < kSpinsBeforeSleep) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> guard{ sleepLock };
+        producerSleeping.store(true);
+        wakeup.wait(guard, hasRoom);
+        producerSleeping.store(false);
+    }
+    if (closed.load()) {
+        return false;
+    }
+
+    slots[position & mask] = std::move(item);
+    tail.store(position + 1);
+    wake(consumerSleeping);
+    return true;
+}
+
+// mirror image of push; a closed ring still hands out what it holds
+template <typename T>
+bool SpscRing<T>::pop(T& item) {
+    size_t position = head.load(std::memory_order_relaxed);
+    auto hasItem = [&]{ return tail.load() != position || closed.load(); };
+    for (int spin = 0; !hasItem(); ++spin) {
+        if (spin < kSpinsBeforeSleep) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> guard{ sleepLock };
+        consumerSleeping.store(true);
+        wakeup.wait(guard, hasItem);
+        consumerSleeping.store(false);
+    }
+    if (tail.load() == position) {
+        return false;
+    }
+
+    item = std::move(slots[position & mask]);
+    head.store(position + 1);
+    wake(producerSleeping);
+    return true;
+}
+
+// either side may be the one asleep
+template <typename T>
+void SpscRing<T>::close() {
+    closed.store(true);
+    std::lock_guard<std::mutex> guard{ sleepLock };
+    wakeup.notify_all();
+}
+
+// both sides share one condition variable, so wake everyone on it
+template <typename T>
+void SpscRing<T>::wake(const std::atomic<bool>& sleeping) {
+    if (sleeping.load()) {
+        std::lock_guard<std::mutex> guard{ sleepLock };
+        wakeup.notify_all();
+    }
+}
+
+#endif
@@ -0,0 +1,74 @@
+#include "TaskQueue.h"                                  // file-specific header
+#include <atomic>                                       // for atomic, memory_order
+#include <mutex>                                        // for mutex, lock_guard, unique_lock
+#include <thread>                                       // for yield
+#include <utility>                                      // for move
+
+using std::lock_guard; using std::unique_lock; using std::mutex;
+using std::memory_order_acquire; using std::memory_order_release; using std::memory_order_acq_rel;
+
+static const constexpr int kSpinsBeforeSleep = 64;      // empty polls before the consumer sleeps
+
+
+// constructor; both ends start at an empty stub node
+TaskQueue::TaskQueue()
+    : newest{ nullptr }, oldest{ new Node{} }, sleeping{ false }, sleepLock{}, wakeup{} {
+
+    oldest->next.store(nullptr, memory_order_release);
+    newest.store(oldest, memory_order_release);
+}
+
+// destructor
+TaskQueue::~TaskQueue() {
+    while (oldest) {
+        Node* next = oldest->next.load(memory_order_acquire);
+        delete oldest;
+        oldest = next;
+    }
+}
+
+// the displaced node is linked only after the swap, so the consumer can
+// briefly see a shorter queue than was pushed; the sleeping check comes
+// after the link, so a consumer that slept too early is always woken
+void TaskQueue::push(Task task) {
+    Node* node = new Node{};
+    node->next.store(nullptr, memory_order_release);
+    node->task = std::move(task);
+    Node* previous = newest.exchange(node, memory_order_acq_rel);
+    previous->next.store(node);
+
+    if (sleeping.load()) {
+        lock_guard<mutex> guard{ sleepLock };
+        wakeup.notify_one();
+    }
+}
+
+// spin a little before paying for a sleep and a wakeup
+TaskQueue::Task TaskQueue::pop() {
+    Task task{};
+    while (true) {
+        for (int spin = 0; spin < kSpinsBeforeSleep; ++spin) {
+            if (tryPop(task)) {
+                return task;
+            }
+            std::this_thread::yield();
+        }
+
+        unique_lock<mutex> guard{ sleepLock };
+        sleeping.store(true);
+        wakeup.wait(guard, [this]{ return oldest->next.load() != nullptr; });
+        sleeping.store(false);
+    }
+}
+
+// the next node becomes the new stub once its task is taken
+bool TaskQueue::tryPop(Task& task) {
+    Node* next = oldest->next.load(memory_order_acquire);
+    if (!next) {
+        return false;
+    }
+    task = std::move(next->task);
+    delete oldest;
+    oldest = next;
+    return true;
+}
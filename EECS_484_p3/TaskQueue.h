@@ -0,0 +1,67 @@
+#ifndef EECS484P3_TASK_QUEUE_H
+#define EECS484P3_TASK_QUEUE_H
+
+#include <atomic>                                       // for atomic
+#include <condition_variable>                           // for condition_variable
+#include <functional>                                   // for function
+#include <mutex>                                        // for mutex
+
+
+// Unbounded queue of tasks that any number of threads may push onto while a
+// single thread pops them off in the order they were pushed. Pushing never
+// locks: a producer swaps itself in as the newest node and then links the
+// node it displaced to it. The consumer takes a lock only to go to sleep
+// once it finds the queue empty, and producers only to wake it.
+class TaskQueue {
+    public:
+        using Task = std::function<void()>;
+
+        // [Constructor]
+        TaskQueue();
+
+        // [Destructor]
+        // MODIFIES: memory pool
+        // EFFECTS:  deallocates every task still in <this> TaskQueue without
+        //   running it
+        ~TaskQueue();
+
+        // [Copy/Move Constructors and Assignment Operators]
+        // EFFECTS:  disables the copying or moving of TaskQueues
+        TaskQueue(const TaskQueue& other) = delete;
+        TaskQueue(TaskQueue&& other) = delete;
+        TaskQueue& operator=(const TaskQueue& rhs) = delete;
+        TaskQueue& operator=(TaskQueue&& rhs) = delete;
+
+        // [Pusher]
+        // MODIFIES: <this>
+        // EFFECTS:  appends <task> to <this> TaskQueue, waking the consumer if
+        //   it is asleep; safe to call from any number of threads at once
+        void push(Task task);
+
+        // [Popper]
+        // REQUIRES: only one thread ever pops from <this> TaskQueue
+        // MODIFIES: <this>
+        // EFFECTS:  removes and returns the oldest task in <this> TaskQueue,
+        //   spinning briefly and then sleeping until there is one
+        Task pop();
+
+    private:
+        struct Node {
+            std::atomic<Node*> next;
+            Task task;
+        };
+
+        // [Try Popper]
+        // MODIFIES: <this>, <task>
+        // EFFECTS:  moves the oldest task into <task> and returns TRUE, or
+        //   returns FALSE if no push has finished linking its task in
+        bool tryPop(Task& task);
+
+        std::atomic<Node*> newest;                      // swapped by producers
+        Node* oldest;                                   // owned by the consumer; its task was already taken
+        std::atomic<bool> sleeping;                     // TRUE while the consumer waits on <wakeup>
+        std::mutex sleepLock;
+        std::condition_variable wakeup;
+};
+
+#endif
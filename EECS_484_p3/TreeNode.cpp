@@ -1,35 +1,222 @@
 #include "InnerNode.h"                                  // for InnerNode
+#include "LeafNode.h"                                   // for LeafNode
 #include "TreeNode.h"                                   // file-specific header
+#include "TreePolicy.h"                                 // for TreeContext
 #include "Utilities.h"                                  // for DataEntry
 #include <cassert>                                      // for assert
+#include <type_traits>                                  // for conditional_t, is_const
+#include <vector>                                       // for vector
+
+using std::vector;
+
+// the leaf or inner node type matching the constness of <Node>
+template <typename Node>
+using LeafOf = std::conditional_t<std::is_const<Node>::value, const LeafNode, LeafNode>;
+template <typename Node>
+using InnerOf = std::conditional_t<std::is_const<Node>::value, const InnerNode, InnerNode>;
+template <typename Node>
+using EntryOf = std::conditional_t<std::is_const<Node>::value, const DataEntry, DataEntry>;
+
+
+// [Leaf Descender]
+// EFFECTS:  returns the leaf below <node> whose key range holds <key>; the
+//   inner levels are a loop of inlined routing steps, the tag alone telling
+//   when it reaches the leaf
+template <typename Node>
+static LeafOf<Node>* descend(Node* node, const Key& key) {
+    while (!node->isLeaf()) {
+        node = static_cast<InnerOf<Node>*>(node)->childToward(key);
+    }
+    return static_cast<LeafOf<Node>*>(node);
+}
+
+// [Settling Descender]
+// EFFECTS:  descends from <node> toward <key> like the above and returns
+//   the live data entry a lookup of <key> sees, or nullptr if there is
+//   none: the first buffered delete or replacement on the way settles it;
+//   a plain buffered insert only stands in for a key nothing below holds,
+//   so the oldest one passed is the answer if the rest of the way is empty
+template <typename Node>
+static EntryOf<Node>* settle(Node* node, const Key& key) {
+    EntryOf<Node>* inserted = nullptr;
+    while (!node->isLeaf()) {
+        auto inner = static_cast<InnerOf<Node>*>(node);
+        auto message = inner->bufferedMessage(key);
+        if (message && message->isDelete) {
+            return inserted;
+        }
+        if (message && message->replaces) {
+            return &message->entry;
+        }
+        if (message) {
+            inserted = &message->entry;
+        }
+        node = inner->childToward(key);
+    }
+    auto entry = static_cast<LeafOf<Node>*>(node)->findEntry(key);
+    return entry ? entry : inserted;
+}
 
 
 // constructor
-TreeNode::TreeNode(InnerNode* parent)
-    : parent{ parent } {}
+TreeNode::TreeNode(NodeKind kind, InnerNode* parent)
+    : kind{ kind }, parent{ parent }, fence{} {}
 
 // destructor (no memory to deallocate)
 TreeNode::~TreeNode() {}
 
 // call generic insert (get derived class behavior), then check
 // parent to return root
-TreeNode* TreeNode::insertIntoRoot(const DataEntry& newEntry) {
+TreeNode* TreeNode::insertIntoRoot(const DataEntry& newEntry, const TreeContext& context) {
     assert(!parent);
     
-    insertEntry(newEntry);
+    insertEntry(newEntry, context);
     if (parent) {                       // nullptr is FALSE, means no parent (i.e. root)
         return parent;
     }
     return this;
 }
 
-// use maximum and sorted invariant
+// only leaves hold entries; inner nodes route to one
+void TreeNode::insertEntry(const DataEntry& newEntry, const TreeContext& context) {
+    findLeaf(newEntry)->insertEntry(newEntry, context);
+}
+
+// only leaves hold entries; inner nodes route to one, and each borrow or
+// merge on the way back up fences the nodes it moves a separator between
+void TreeNode::deleteEntry(const DataEntry& entryToRemove, const TreeContext& context) {
+    findLeaf(entryToRemove)->deleteEntry(entryToRemove, context);
+}
+
+// the leftmost leaf holds the minimum
+Key TreeNode::minKey() const {
+    const TreeNode* node = this;
+    while (!node->isLeaf()) {
+        node = static_cast<const InnerNode*>(node)->firstChild();
+    }
+    return static_cast<const LeafNode*>(node)->minKey();
+}
+
+// the rightmost leaf holds the maximum
+Key TreeNode::maxKey() const {
+    const TreeNode* node = this;
+    while (!node->isLeaf()) {
+        node = static_cast<const InnerNode*>(node)->lastChild();
+    }
+    return static_cast<const LeafNode*>(node)->maxKey();
+}
+
+// every leaf is at the same depth, so count the levels down the left edge
+size_t TreeNode::height() const {
+    size_t levels = 0;
+    for (const TreeNode* node = this; !node->isLeaf(); node = static_cast<const InnerNode*>(node)->firstChild()) {
+        ++levels;
+    }
+    return levels;
+}
+
+// even a plain insert leaves its key live, so the first buffered message
+// on the way settles it
+bool TreeNode::contains(const Key& key) const {
+    bool found = false;
+    const TreeNode* node = this;
+    while (node) {
+        node = node->stepToward(key, found);
+    }
+    return found;
+}
+
+// follow separators down to the leaf
+LeafNode* TreeNode::findLeaf(const Key& key) {
+    return descend(this, key);
+}
+
+// follow separators down to the leaf
+const LeafNode* TreeNode::findLeaf(const Key& key) const {
+    return descend(this, key);
+}
+
+// the buffers may hold the copy a lookup sees
+const DataEntry& TreeNode::operator[](const Key& key) const {
+    assert(contains(key));
+
+    return *settle(this, key);
+}
+
+// the buffers may hold the copy a lookup sees
+DataEntry* TreeNode::findEntry(const Key& key) {
+    return settle(this, key);
+}
+
+// descend to the leaf where <begin> would be, then walk the leaf chain
+vector<DataEntry> TreeNode::rangeFind(const Key& begin, const Key& end) const {
+    assert(end >= begin);
+
+    return findLeaf(begin)->rangeFind(begin, end);
+}
+
+// branch on the tag instead of the vtable
+void TreeNode::prefetchContents() const {
+    if (isLeaf()) {
+        static_cast<const LeafNode*>(this)->prefetchContents();
+    }
+    else {
+        static_cast<const InnerNode*>(this)->prefetchContents();
+    }
+}
+
+// branch on the tag instead of the vtable
+const TreeNode* TreeNode::stepToward(const Key& key, bool& found) const {
+    if (isLeaf()) {
+        return static_cast<const LeafNode*>(this)->stepToward(key, found);
+    }
+    return static_cast<const InnerNode*>(this)->stepToward(key, found);
+}
+
+// return fence
+const Fence& TreeNode::getFence() const {
+    return fence;
+}
+
+// an unchanged fence means nothing below changed either
+void TreeNode::updateFence(const Fence& newFence) {
+    if (fence == newFence) {
+        return;
+    }
+    fence = newFence;
+    if (!isLeaf()) {
+        static_cast<InnerNode*>(this)->fenceChildren();
+    }
+}
+
+// every node whose separators moved lies on the path or hangs off it with
+// a fence that moved too, which its parent on the path notices
+void TreeNode::repairFences(const Key& key) {
+    assert(!parent);
+
+    updateFence(Fence{});
+    for (TreeNode* node = this; !node->isLeaf(); ) {
+        auto inner = static_cast<InnerNode*>(node);
+        inner->fenceChildren();
+        node = inner->childToward(key);
+    }
+}
+
+// the fence settles it unless the node reaches the open top of the tree;
+// otherwise use maximum and sorted invariant
 bool TreeNode::operator<(const Key& key) const {
+    if (fence.hasHigh && fence.high <= key) {
+        return true;
+    }
     return (maxKey() < key);
 }
 
-// use minimum and sorted invariant
+// the fence settles it unless the node reaches the open bottom of the
+// tree; otherwise use minimum and sorted invariant
 bool TreeNode::operator>=(const Key& key) const {
+    if (fence.hasLow && fence.low >= key) {
+        return true;
+    }
     return (minKey() >= key);
 }
 
@@ -38,6 +225,15 @@ void TreeNode::updateParent(InnerNode* newParent) {
     parent = newParent;
 }
 
+// follow parents up until there are none
+TreeNode* TreeNode::findRoot() {
+    TreeNode* node = this;
+    while (node->parent) {
+        node = node->parent;
+    }
+    return node;
+}
+
 // return parent
 InnerNode* TreeNode::getParent() {
     return parent;
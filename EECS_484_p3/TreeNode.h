@@ -3,69 +3,277 @@
 
 #include "DataEntry.h"                                          // for DataEntry (template parameter)
 #include "Utilities.h"                                          // for Key primitive alias
-#include <iosfwd>                                               // for ostream forward declaration
+#include <array>                                                // for array
+#include <map>                                                  // for map
+#include <string>                                               // for string
 #include <vector>                                               // for vector (forward declaration is difficult)
 
 class InnerNode;                                                // only used as pointer or function argument
+class LeafNode;                                                 // only used as pointer
+class OutputBuffer;                                             // only used as function argument
+struct TreeContext;                                             // only used as function argument
+struct TreePolicy;                                              // only used as function argument
 
 
+// half-open key range [low, high) that a subtree is responsible for; a
+// missing bound leaves the range open on that side
+struct Fence {
+    bool hasLow = false;
+    Key low = 0;
+    bool hasHigh = false;
+    Key high = 0;
+
+    // EFFECTS:  returns TRUE if and only if <key> lies inside <this> Fence
+    bool contains(const Key& key) const {
+        return ((!hasLow || key >= low) && (!hasHigh || key < high));
+    }
+
+    // EFFECTS:  returns TRUE if and only if <this> Fence and <rhs> bound the
+    //   same range (or different ones); an open side ignores its key
+    bool operator==(const Fence& rhs) const {
+        return (hasLow == rhs.hasLow && (!hasLow || low == rhs.low) &&
+                hasHigh == rhs.hasHigh && (!hasHigh || high == rhs.high));
+    }
+    bool operator!=(const Fence& rhs) const {
+        return !(*this == rhs);
+    }
+};
+
+// pending insert or delete held in an inner node's buffer in buffered mode;
+// messages are sent without looking below, so an insert only takes effect if
+// its key is not live by the time it arrives, and a delete of an absent key
+// does nothing
+struct BufferedMessage {
+    DataEntry entry;
+    bool isDelete;
+    bool replaces = false;                                      // insert that followed a delete of its key, so it overwrites a live entry
+
+    // the one message with the effect of <older>, sent earlier for the same
+    // key, followed by <this>; only a plain insert yields to what it follows
+    BufferedMessage after(const BufferedMessage& older) const {
+        if (isDelete || replaces) {
+            return *this;
+        }
+        return older.isDelete ? BufferedMessage{ entry, false, true } : older;
+    }
+
+    // the change in live entries <this> is counted as until it reaches a
+    // leaf: a plain insert adds its key, a delete removes it, and an insert
+    // that replaces puts back what the delete before it removed
+    long guess() const {
+        return isDelete ? -1 : (replaces ? 0 : 1);
+    }
+};
+
+// change in the live and dead entry counts below a node once buffered
+// messages reach its leaves, and in the guessed effect of the messages
+// still buffered, which folding or applying them moves
+struct EntryDelta {
+    long live = 0;
+    long dead = 0;
+    long guessed = 0;
+
+    EntryDelta& operator+=(const EntryDelta& rhs) {
+        live += rhs.live;
+        dead += rhs.dead;
+        guessed += rhs.guessed;
+        return *this;
+    }
+};
+
+// result of verifying one subtree, combined bottom-up by the parent
+struct SubtreeSummary {
+    size_t entries = 0;                                         // live data entries in the leaves of the subtree, buffered messages aside
+    size_t tombstones = 0;                                      // entries marked dead by lazy deletes
+    long guessed = 0;                                           // summed guesses of the buffered messages
+    size_t depth = 0;                                           // edges from subtree root to each leaf
+    const LeafNode* first = nullptr;                            // leftmost leaf of the subtree
+    const LeafNode* last = nullptr;                             // rightmost leaf of the subtree
+    std::string failure{};                                      // first violated invariant, empty if none
+};
+
+// bytes held by a tree and how well its nodes are packed, gathered in one
+// walk over the nodes; node bytes count each node object plus the full
+// heap capacity of its vectors, so unused capacity is included
+struct MemoryReport {
+    static const constexpr size_t kFillBuckets = 10;            // fill histogram buckets, a tenth of a node each
+
+    size_t leafNodes = 0;
+    size_t innerNodes = 0;
+    size_t leafBytes = 0;
+    size_t innerBytes = 0;
+    size_t leafSlackBytes = 0;                                  // vector capacity past the size, part of leafBytes
+    size_t innerSlackBytes = 0;                                 // likewise, part of innerBytes
+    size_t treeBytes = 0;                                       // the BTree object and what it holds outside the nodes
+    size_t leafEntries = 0;                                     // live and dead entries across every leaf
+    std::vector<size_t> nodesPerLevel{};                        // node count by depth, the root level first
+    std::array<size_t, kFillBuckets> leafFill{};                // leaves by entries over capacity; full ones go last
+    std::array<size_t, kFillBuckets> innerFill{};               // inner nodes by keys over capacity, likewise
+    double averageLeafOccupancy = 0;                            // leaf entries over total leaf capacity
+
+    // EFFECTS:  returns every byte counted above
+    size_t totalBytes() const {
+        return leafBytes + innerBytes + treeBytes;
+    }
+
+    // EFFECTS:  returns the histogram bucket of a node holding <used> of
+    //   <capacity> slots
+    static size_t fillBucket(size_t used, size_t capacity) {
+        size_t bucket = used * kFillBuckets / capacity;
+        return (bucket < kFillBuckets) ? bucket : kFillBuckets - 1;
+    }
+};
+
+
+// what a TreeNode is, stored in the node itself so traversals can branch on
+// it and call the leaf or inner node directly instead of through the vtable
+enum class NodeKind : unsigned char {
+    Leaf,
+    Inner
+};
+
+
+// Base of both node types. The routines every lookup or update runs on its
+// way down (descent, containment, finders, min/max, height and the entry
+// point of insert and delete) are not virtual: they loop over inner nodes
+// by their kind tag and finish with a direct call on the leaf, so the
+// per-node steps inline. Everything else dispatches virtually.
 class TreeNode {
     public:
         // [Constructor]
         // REQUIRES: <parent> is not <this>
-        explicit TreeNode(InnerNode* parent = nullptr);
+        explicit TreeNode(NodeKind kind, InnerNode* parent = nullptr);
 
         // [Destructor]
         // MODIFIES: memory pool
         // EFFECTS:  virtually destroys all memory managed by <this> TreeNode
         virtual ~TreeNode();
 
+        // [Kind Accessors]
+        // EFFECTS:  returns the kind of <this> TreeNode, or whether it is a leaf
+        NodeKind getKind() const {
+            return kind;
+        }
+        bool isLeaf() const {
+            return kind == NodeKind::Leaf;
+        }
+
         // [Insert when Root Node]
         // REQUIRES: <this> TreeNode's parent is nullptr, no data entry in
         //   <this> TreeNode or any of <this> TreeNode's descendants has the
         //   same key as <newEntry>
-        // MODIFIES: <this>, the TreeNodes in the same BTree as <this>
+        // MODIFIES: <this>, the TreeNodes in the same BTree as <this>, the
+        //   stats of <context>
         // EFFECTS:  inserts <newEntry> into the appropriate location in <this>
         //   TreeNode or one of <this> TreeNode's children, increasing the
-        //   height of the BTree whose root is <this> if necessary; after the
-        //   insertion is completed, returns the root of that BTree, which
-        //   may have changed due to height increase
-        TreeNode* insertIntoRoot(const DataEntry& newEntry);
+        //   height of the BTree whose root is <this> if necessary, as the
+        //   policy of <context> decides; after the insertion is completed,
+        //   returns the root of that BTree, which may have changed due to
+        //   height increase
+        TreeNode* insertIntoRoot(const DataEntry& newEntry, const TreeContext& context);
 
         // [Delete when Root Node]
         // REQUIRES: <this> TreeNode's parent is nullptr, <entryToRemove> is a
         //   data entry in <this> TreeNode or one of <this> TreeNode's
         //   descendants
-        // MODIFIES: <this>, the TreeNodes in the same BTree as <this>
+        // MODIFIES: <this>, the TreeNodes in the same BTree as <this>, the
+        //   stats of <context>
         // EFFECTS:  removes <entryToRemove> from <this> TreeNode or one of
         //   <this> TreeNode's children, decreasing the height of the BTree
-        //   whose root is <this> if necessary; after the removal is complete,
-        //   returns the root of that BTree, which may have changed due to
-        //   height decrease
-        virtual TreeNode* deleteFromRoot(const DataEntry& entryToRemove) = 0;
+        //   whose root is <this> if necessary, as the policy of <context>
+        //   decides; after the removal is complete, returns the root of that
+        //   BTree, which may have changed due to height decrease
+        virtual TreeNode* deleteFromRoot(const DataEntry& entryToRemove, const TreeContext& context) = 0;
 
         // [Generic Insert]
         // REQUIRES: no data entry in <this> TreeNode or any of <this> TreeNode's
         //   descendants has the same key as <newEntry>
-        // MODIFIES: <this>, the TreeNodes in the same BTree as <this>
+        // MODIFIES: <this>, the TreeNodes in the same BTree as <this>, the
+        //   stats of <context>
         // EFFECTS:  inserts <newEntry> into the appropriate location in <this>
         //   TreeNode or one of <this> TreeNode's children, increasing the
-        //   height of the BTree whose root is <this> if necessary
-        virtual void insertEntry(const DataEntry& newEntry) = 0;
+        //   height of the BTree whose root is <this> if necessary, as the
+        //   policy of <context> decides
+        void insertEntry(const DataEntry& newEntry, const TreeContext& context);
 
         // [Generic Delete]
         // REQUIRES: <entryToRemove> is a data entry in <this> TreeNode or one
         //   of <this> TreeNode's descendants
-        // MODIFIES: <this>, the TreeNodes in the same BTree as <this>
+        // MODIFIES: <this>, the TreeNodes in the same BTree as <this>, the
+        //   stats of <context>
         // EFFECTS:  removes <entryToRemove> from <this> TreeNode or one of
         //   <this> TreeNode's children, decreasing the height of the BTree
-        //   whose root is <this> if necessary
-        virtual void deleteEntry(const DataEntry& entryToRemove) = 0;
+        //   whose root is <this> if necessary, as the policy of <context>
+        //   decides
+        void deleteEntry(const DataEntry& entryToRemove, const TreeContext& context);
+
+        // [Message Absorber]
+        // REQUIRES: <batch> is strictly increasing by key and every key in it
+        //   lies in the key range of <this> TreeNode
+        // MODIFIES: <this>, the TreeNodes in the same BTree as <this>, the
+        //   stats of <context>
+        // EFFECTS:  applies <batch> to <this> TreeNode: a leaf inserts (or
+        //   revives) the entries of insert messages whose key is not live and
+        //   marks the entries of delete messages dead; an inner node adds the
+        //   messages to its buffer and flushes whenever the buffer overfills;
+        //   splits follow the policy of <context>; returns the change in the
+        //   numbers of live and dead entries below <this>, and in the guessed
+        //   effect of the messages still buffered, those of <batch> included
+        virtual EntryDelta absorb(const std::vector<BufferedMessage>& batch, const TreeContext& context) = 0;
+
+        // [Buffer Flusher]
+        // MODIFIES: <this>, the TreeNodes in the same BTree as <this>, the
+        //   stats of <context>
+        // EFFECTS:  pushes every buffered message in <this> TreeNode and its
+        //   descendants down to the leaves, splitting as the policy of
+        //   <context> decides; returns the change in the numbers of live and
+        //   dead entries below <this>, and in the guessed effect of the
+        //   messages still buffered
+        virtual EntryDelta flushAll(const TreeContext& context) = 0;
+
+        // [Message Collector]
+        // REQUIRES: <end> >= <begin>
+        // MODIFIES: <pending>
+        // EFFECTS:  adds to <pending> every buffered message in <this>
+        //   TreeNode or its descendants whose key is in the range [<begin>,
+        //   <end>], combining the messages for each key into one with the
+        //   same effect; messages already in <pending> are taken to be newer
+        virtual void collectMessages(const Key& begin, const Key& end,
+                                     std::map<Key, BufferedMessage>& pending) const = 0;
+
+        // [Root Finder]
+        // EFFECTS:  returns the root of the BTree containing <this> TreeNode
+        TreeNode* findRoot();
+
+        // [Fence Accessor]
+        // EFFECTS:  returns the key range of <this> TreeNode, bounded by the
+        //   nearest separator of an ancestor on each side and open on a side
+        //   with none; every key <this> TreeNode or its descendants hold lies
+        //   inside it
+        const Fence& getFence() const;
+
+        // [Fence Modifier]
+        // MODIFIES: <this>, the descendants of <this> TreeNode
+        // EFFECTS:  makes <newFence> the key range of <this> TreeNode and, if
+        //   that changed it, re-derives the fences of its children from their
+        //   separators, carrying the change down only as far as it reaches
+        void updateFence(const Fence& newFence);
+
+        // [Path Fence Repairer]
+        // REQUIRES: <this> TreeNode is a root, and every fence in its tree
+        //   is current except those a restructure around the path toward
+        //   <key> left stale
+        // MODIFIES: <this>, the TreeNodes below it
+        // EFFECTS:  opens the fence of <this> TreeNode, then re-derives the
+        //   fences of the children of every inner node on the path from
+        //   <this> toward <key>
+        void repairFences(const Key& key);
 
         // [Comparators]
         // EFFECTS:  returns TRUE if and only if all data entries in <this>
         //   TreeNode or all of <this> TreeNode's descendants have keys that
-        //   are less than (or greater than or equal to) <key>
+        //   are less than (or greater than or equal to) <key>; answered from
+        //   the fence of <this> TreeNode when it settles the question
         bool operator<(const Key& key) const;
         bool operator>=(const Key& key) const;
 
@@ -73,36 +281,94 @@ class TreeNode {
         // EFFECTS:  returns the minimum (or maximum) key of all data entries
         //   in <this> TreeNode or any of <this> TreeNode's descendants; returns
         //   the minimum (or maximum) possible key if <this> TreeNode is empty
-        virtual Key minKey() const = 0;
-        virtual Key maxKey() const = 0;
+        Key minKey() const;
+        Key maxKey() const;
+
+        // [Height Accessor]
+        // EFFECTS:  returns the number of edges on the path from <this>
+        //   TreeNode down to any leaf below it
+        size_t height() const;
 
         // [Containment Checker]
         // EFFECTS:  returns TRUE if and only if there is a data entry in <this>
         //   TreeNode or one of <this> TreeNode's descendants whose key is <key>
         //   (key version); or if <this> TreeNode or one of <this> TreeNode's
         //   descendants is <node> (node version)
-        virtual bool contains(const Key& key) const = 0;
+        bool contains(const Key& key) const;
         virtual bool contains(const TreeNode* node) const = 0;
 
+        // [Leaf Finder]
+        // EFFECTS:  returns the leaf among <this> TreeNode and its descendants
+        //   whose key range would hold a data entry with key <key>, found by
+        //   following separators down from <this>
+        LeafNode* findLeaf(const Key& key);
+        const LeafNode* findLeaf(const Key& key) const;
+
         // [Single-Value Finder]
         // REQUIRES: there is a data entry in <this> TreeNode or one of <this>
         //   TreeNode's descendants whose key is <key>
         // EFFECTS:  returns the data entry in <this> TreeNode or one of <this>
         //   TreeNode's descendants whose key is <key>
-        virtual const DataEntry& operator[](const Key& key) const = 0;
+        const DataEntry& operator[](const Key& key) const;
+
+        // [Entry Locator]
+        // EFFECTS:  returns the live data entry whose key is <key> that a
+        //   lookup among <this> TreeNode and its descendants sees, whether it
+        //   is still a buffered message or already in a leaf, so its record
+        //   can be replaced in place; returns nullptr if there is none
+        DataEntry* findEntry(const Key& key);
 
         // [Range Value Finder]
         // REQUIRES: <end> >= <begin>
         // EFFECTS:  returns a vector consisting of every data entry in <this>
         //   TreeNode or <this> TreeNode's descendants whose key is in the range
         //   [<begin>, <end>] (both endpoints inclusive)
-        virtual std::vector<DataEntry> rangeFind(const Key& begin, const Key& end) const = 0;
+        std::vector<DataEntry> rangeFind(const Key& begin, const Key& end) const;
+
+        // [Lookup Steppers]
+        // MODIFIES: <found> (step only)
+        // EFFECTS:  issues prefetches for the memory a lookup step on <this>
+        //   TreeNode will read; or takes one step of a lookup of <key>,
+        //   returning the child whose key range holds <key>, or nullptr once
+        //   <this> TreeNode settles the lookup, with <found> set to whether
+        //   <key> is live
+        void prefetchContents() const;
+        const TreeNode* stepToward(const Key& key, bool& found) const;
+
+        // [Batch Finder]
+        // REQUIRES: the keys in [<first>, <last>) are sorted, <hits> begins
+        //   one slot per key, every slot nullptr
+        // MODIFIES: <hits>
+        // EFFECTS:  points the slot of every key in [<first>, <last>) that
+        //   has a live data entry among <this> TreeNode and its descendants at
+        //   that entry, visiting each node at most once for the whole batch
+        virtual void findMany(std::vector<Key>::const_iterator first, std::vector<Key>::const_iterator last,
+                              std::vector<const DataEntry*>::iterator hits) const = 0;
 
         // [Printer]
         // REQUIRES: <indent> >= 0
-        // MODIFIES: <os>
-        // EFFECTS:  prints <this> TreeNode to <os>
-        virtual void print(std::ostream& os, int indent = 0) const = 0;
+        // MODIFIES: <out>
+        // EFFECTS:  prints <this> TreeNode to <out>
+        virtual void print(OutputBuffer& out, int indent = 0) const = 0;
+
+        // [Subtree Verifier]
+        // REQUIRES: <threads> >= 1
+        // EFFECTS:  checks that the subtree rooted at <this> TreeNode has
+        //   sorted keys that all lie inside <fence>, occupancy legal under
+        //   <policy> (treating <this> as the root if <expectedParent> is
+        //   nullptr), cached fences matching the separators, leaves at a
+        //   uniform depth, correct parent pointers and a leaf chain linking
+        //   adjacent subtrees, using up to <threads> threads; returns the
+        //   summary of the subtree, whose failure describes the first
+        //   violation found and is empty if there is none
+        virtual SubtreeSummary verify(const Fence& fence, const InnerNode* expectedParent,
+                                      const TreePolicy& policy, size_t threads) const = 0;
+
+        // [Memory Measurer]
+        // MODIFIES: <report>
+        // EFFECTS:  adds the node counts, bytes and fill of <this> TreeNode and
+        //   its descendants to <report>, taking <this> to sit at depth <level>
+        virtual void measure(MemoryReport& report, size_t level) const = 0;
 
         // [Parent Modifier]
         // EFFECTS:  updates the parent of <this> TreeNode to be <newParent>
@@ -138,7 +404,9 @@ class TreeNode {
         virtual bool satisfiesInvariant() const;
 
     private:
+        const NodeKind kind;
         InnerNode* parent;
+        Fence fence;
 };
 
 #endif
@@ -0,0 +1,27 @@
+#include "TreePolicy.h"                                 // file-specific header
+#include "Utilities.h"                                  // for size constants
+
+
+// strict keeps half full, free-at-empty only needs one entry
+size_t TreePolicy::leafMinimum() const {
+    switch (rebalance) {
+        case Rebalance::Threshold:
+            return leafThreshold;
+        case Rebalance::FreeAtEmpty:
+            return 1;
+        default:
+            return kLeafOrder;
+    }
+}
+
+// strict keeps half full, free-at-empty allows single-child nodes
+size_t TreePolicy::innerMinimum() const {
+    switch (rebalance) {
+        case Rebalance::Threshold:
+            return innerThreshold;
+        case Rebalance::FreeAtEmpty:
+            return 0;
+        default:
+            return kInnerOrder;
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef EECS484P3_TREE_POLICY_H
+#define EECS484P3_TREE_POLICY_H
+
+#include "Utilities.h"                                  // for size constants
+#include <cstddef>                                      // for size_t
+
+
+// how an underfull node is repaired after a delete
+enum class Rebalance {
+    Strict,                                             // keep every node at least half full
+    Threshold,                                          // borrow/merge only below a configured minimum
+    FreeAtEmpty                                         // never borrow or merge; free nodes once empty
+};
+
+// where an overfull node is cut in two
+enum class Split {
+    Even,                                               // always split at the middle
+    Edge                                                // inserts past the first or last key of the tree
+                                                        //   split off as little as the minimum allows
+};
+
+// how a node finds a key among its sorted keys
+enum class Search {
+    Binary,                                             // binary search over the whole node
+    Interpolation                                       // nodes split or bulk-loaded from now on fit a
+                                                        //   linear model of key to slot and search
+                                                        //   only around the slot it predicts
+};
+
+// tunables of a single BTree
+struct TreePolicy {
+    Rebalance rebalance = Rebalance::Strict;
+    Split split = Split::Even;
+    Search search = Search::Binary;
+    size_t leafThreshold = kLeafOrder;                  // minimum entries per leaf under Threshold
+    size_t innerThreshold = kInnerOrder;                // minimum keys per inner node under Threshold
+
+    // EFFECTS:  returns the fewest data entries a non-root leaf (or keys a
+    //   non-root inner node) may hold before it must be repaired
+    size_t leafMinimum() const;
+    size_t innerMinimum() const;
+};
+
+// running counts of structural changes, for comparing policies
+struct RestructureStats {
+    size_t leafSplits = 0;
+    size_t innerSplits = 0;
+    size_t leafBorrows = 0;
+    size_t innerBorrows = 0;
+    size_t leafMerges = 0;
+    size_t innerMerges = 0;
+    size_t leafFrees = 0;
+    size_t innerFrees = 0;
+    size_t bufferFlushes = 0;                           // batches pushed from an inner node's buffer to a child
+};
+
+
+// the policy and counters of the BTree an operation runs on; nodes only
+// know their parent, not their tree, so every node routine that may split,
+// rebalance or flush is handed one by the BTree that called it
+struct TreeContext {
+    const TreePolicy& policy;
+    RestructureStats& stats;
+};
+
+#endif
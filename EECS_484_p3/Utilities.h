@@ -9,7 +9,18 @@ using Record = int;
 
 const constexpr size_t kLeafOrder = 1;              // order of leaf nodes, must be at least 1
 const constexpr size_t kInnerOrder = 1;             // order of inner nodes, must be at least 1
+const constexpr size_t kInnerBufferSize = 8 * kInnerOrder;  // pending messages per inner node in buffered mode
+const constexpr size_t kLookupGroupSize = 8;        // lookups BTree::containsMany keeps in flight by default
 extern const char* kPrintPrefix;
 extern const int kIndentIncr;
 
+// hint that <address> will be read soon; does nothing where unsupported
+inline void prefetch(const void* address) {
+#if defined(__GNUC__)
+    __builtin_prefetch(address);
+#else
+    (void)address;
+#endif
+}
+
 #endif
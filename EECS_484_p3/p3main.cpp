@@ -1,26 +1,105 @@
 #include "BTree.h"                                      // for BTree
 #include "DataEntry.h"                                  // for DataEntry
+#include "LatencyHistogram.h"                           // for LatencyHistogram
+#include "OutputBuffer.h"                               // for OutputBuffer
+#include "SpscRing.h"                                   // for SpscRing
+#include "TreeNode.h"                                   // for MemoryReport
+#include "TreePolicy.h"                                 // for RestructureStats
+#include <algorithm>                                    // for min
+#include <chrono>                                       // for steady_clock, duration_cast
+#include <cstdint>                                      // for uint64_t
 #include <exception>                                    // for exception, bad_alloc
+#include <functional>                                   // for ref, cref
+#include <iomanip>                                      // for setw
 #include <iostream>                                     // for cin, cout, istream, ostream
-#include <string>                                       // for string
+#include <sstream>                                      // for istringstream, ostringstream
+#include <string>                                       // for string, getline
+#include <thread>                                       // for thread
 #include <unordered_map>                                // for unordered_map
+#include <utility>                                      // for move, pair
 #include <vector>                                       // for vector
 
 using std::istream; using std::ostream; using std::cin; using std::cout;
 using std::string; using std::unordered_map;
+using std::istringstream; using std::ostringstream; using std::thread;
 using std::exception; using std::bad_alloc;
+using std::setw; using std::uint64_t;
+using std::chrono::steady_clock; using std::chrono::duration_cast; using std::chrono::nanoseconds;
 
 using ReadException = class : public exception {};
 using CommandException = class : public exception {};
-using ExecFunc_t = void(*)(istream&, BTree&);
+using LatencyMap_t = unordered_map<string, LatencyHistogram>;
+
+// what a command printed, kept as the data it printed so formatting can
+// happen off the thread that runs the tree
+enum class Output {
+    Nothing,                                            // most updates print nothing
+    Text,                                               // already formatted: a printed tree or an error
+    Removed,                                            // how many entries a purge took out
+    Entries,                                            // a range find, in printing order
+    Postings,                                           // keys with their posted records
+    Verified,
+    Violated,                                           // the failed invariant is in <text>
+    Stats,
+    Memory,
+    Latencies
+};
+struct Result {
+    Output kind = Output::Nothing;                      // which of the fields below are printed
+    string text{};
+    size_t removed = 0;
+    std::vector<DataEntry> entries{};
+    std::vector<std::pair<Key, Record>> postings{};
+    RestructureStats stats{};
+    MemoryReport memory{};
+    LatencyMap_t latencies{};
+};
+using ResultBatch_t = std::vector<Result>;
+
+using ExecFunc_t = Result(*)(istream&, BTree&);
 using CommandMap_t = unordered_map<string, ExecFunc_t>;
 
+// a command line as split by the parser thread of the pipelined driver
+struct Command {
+    string name;                                        // first word of the line
+    ExecFunc_t func;                                    // nullptr if <name> is not in the command map
+    string args;                                        // rest of the line, newline included
+};
+using CommandBatch_t = std::vector<Command>;
+
 static const string kInsertCmd = "insert";
 static const string kDeleteCmd = "delete";
+static const string kPurgeCmd = "purge";
 static const string kPrintCmd = "print";
 static const string kRangeFindCmd = "find";
+static const string kReverseFindCmd = "rfind";
+static const string kVerifyCmd = "verify";
+static const string kCompactCmd = "compact";
+static const string kRepackCmd = "repack";
+static const string kRebalanceCmd = "rebalance";
+static const string kStatsCmd = "stats";
+static const string kMemoryCmd = "memory";
+static const string kSplitCmd = "split";
+static const string kSearchCmd = "search";
+static const string kPostCmd = "post";
+static const string kUnpostCmd = "unpost";
+static const string kPostingsCmd = "postings";
+static const string kStrictMode = "strict";
+static const string kThresholdMode = "threshold";
+static const string kFreeAtEmptyMode = "empty";
+static const string kEvenSplit = "even";
+static const string kEdgeSplit = "edge";
+static const string kBinarySearch = "binary";
+static const string kInterpolationSearch = "interpolation";
 static const string kQuitCmd = "quit";
-static ostream* const outStream = &cout;
+static const string kLatencyCmd = "latency";
+static const string kLatencyFlag = "--latency";
+static const string kLazyDeleteFlag = "--lazy-delete";
+static const string kBufferedFlag = "--buffered";
+static const string kMultiValueFlag = "--multi";
+static const string kPipelinedFlag = "--pipelined";
+static const constexpr size_t kPipelineDepth = 64;      // batches or results in flight between threads
+static const constexpr size_t kBatchCommands = 256;     // most commands the parser hands over at once
 
 
 // MODIFIES: <is>
@@ -38,80 +117,408 @@ void dellocateAll(Iter start, Iter end);
 //   first newline character
 void clearLine(istream& is);
 
+// MODIFIES: <is>, <tree>, <latencies>, <result>
+// EFFECTS:  runs <command> by calling <func> on <is> and <tree> and stores
+//   what it printed in <result>, timing it into <latencies> if <timing> is
+//   set ("latency" returns them instead); stores an error and clears the
+//   rest of the line of <is> if the command is unknown (<func> is nullptr)
+//   or misread, and returns FALSE if it failed in a way that must abort
+//   execution
+bool runCommand(const string& command, ExecFunc_t func, istream& is, BTree& tree,
+                bool timing, LatencyMap_t& latencies, Result& result);
+
+// MODIFIES: <os>
+// EFFECTS:  prints <result> to <os> the way its command reports it
+void printResult(ostream& os, const Result& result);
+
+// MODIFIES: cin, <commands>
+// EFFECTS:  reads cin a line at a time, looks the first word of each up in
+//   <cmdMap> and pushes the split lines onto <commands> in batches, skipping
+//   blank and comment lines, until "quit", the end of cin or <commands> is
+//   closed; then closes <commands>
+void parseCommands(const CommandMap_t& cmdMap, SpscRing<CommandBatch_t>& commands);
+
+// MODIFIES: <commands>, <tree>, <results>
+// EFFECTS:  pops batches off <commands> and runs their commands on <tree> in
+//   order, pushing the results of each batch that printed anything onto
+//   <results>, followed by the latencies if <timing> is set; closes
+//   <results> when done and returns FALSE if a command failed in a way that
+//   must abort execution (closing <commands> as well)
+bool executeCommands(SpscRing<CommandBatch_t>& commands, SpscRing<ResultBatch_t>& results, BTree& tree, bool timing);
+
+// MODIFIES: <results>, cout
+// EFFECTS:  prints everything popped off <results> to cout, in order,
+//   until it is closed and drained
+void writeResults(SpscRing<ResultBatch_t>& results);
+
 // MODIFIES: <is>, <tree>
 // EFFECTS:  reads a single integer from <is> and inserts a new
 //   data entry with that key/value into <tree>
-void performInsert(istream& is, BTree& tree);
+Result performInsert(istream& is, BTree& tree);
 
 // MODIFIES: <is>, <tree>
 // EFFECTS:  reads a single integer from <is> and deletes the data
 //   entry from <tree> with that key
-void performDelete(istream& is, BTree& tree);
+Result performDelete(istream& is, BTree& tree);
+
+// MODIFIES: <is>, <tree>
+// EFFECTS:  reads two integers from <is> and deletes every data entry of
+//   <tree> whose key lies between them (both inclusive), returning how
+//   many were removed
+Result performPurge(istream& is, BTree& tree);
+
+// MODIFIES: <is>, <tree>
+// EFFECTS:  reads a key and a record from <is> and adds the record to, or
+//   removes it from, the posting list of that key in <tree>
+Result performPost(istream& is, BTree& tree);
+Result performUnpost(istream& is, BTree& tree);
+
+// MODIFIES: <is>
+// EFFECTS:  reads two integers from <is> and returns every key of <tree>
+//   between them (both inclusive) with its posted records
+Result performPostings(istream& is, BTree& tree);
 
-// MODIFIES: <is>, <tree>, <outStream>
+// MODIFIES: <is>, <tree>
 // EFFECTS:  reads two integers from <is> and and performs a range
-//   find on <tree> using those endpoints, printing the results of
-//   the range find to <outStream>
-void performRangeFind(istream& is, BTree& tree);
+//   find on <tree> using those endpoints, returning the results of
+//   the range find
+Result performRangeFind(istream& is, BTree& tree);
+
+// MODIFIES: <is>
+// EFFECTS:  reads two integers and a limit from <is> and returns at most
+//   that many data entries of <tree> between the two integers (both
+//   inclusive), largest key first
+Result performReverseFind(istream& is, BTree& tree);
 
-// MODIFIES: <outStream>
-// EFFECTS:  prints <tree> to <outStream>
-void performPrint(istream&, BTree& tree);
+// EFFECTS:  returns <tree> as printed text
+Result performPrint(istream&, BTree& tree);
 
+// EFFECTS:  checks every invariant of <tree> and returns the outcome
+Result performVerify(istream&, BTree& tree);
 
-// application driver
-int main() {
+// MODIFIES: <tree>
+// EFFECTS:  reclaims the entries of <tree> marked dead by lazy deletes
+Result performCompact(istream&, BTree& tree);
+
+// MODIFIES: <tree>
+// EFFECTS:  rebuilds <tree> with its leaves laid out in key order
+Result performRepack(istream&, BTree& tree);
+
+// MODIFIES: <is>, <tree>
+// EFFECTS:  reads a rebalancing mode ("strict", "empty", or "threshold"
+//   followed by the leaf and inner minimums) from <is> and makes it the
+//   policy of <tree>; throws a CommandException for an unknown mode
+Result performRebalance(istream& is, BTree& tree);
+
+// MODIFIES: <is>, <tree>
+// EFFECTS:  reads a split mode ("even" or "edge") from <is> and makes it
+//   the split policy of <tree>; throws a CommandException for an unknown
+//   mode
+Result performSplit(istream& is, BTree& tree);
+
+// MODIFIES: <is>, <tree>
+// EFFECTS:  reads a search mode ("binary" or "interpolation") from <is> and
+//   makes it the search policy of <tree>; throws a CommandException for an
+//   unknown mode
+Result performSearch(istream& is, BTree& tree);
+
+// EFFECTS:  returns the restructuring counters of <tree>
+Result performStats(istream&, BTree& tree);
+
+// EFFECTS:  returns the memory report of <tree>
+Result performMemory(istream&, BTree& tree);
+
+// MODIFIES: <os>
+// EFFECTS:  prints the data entries or postings of <result> to <os>
+void printEntries(ostream& os, const Result& result);
+void printPostings(ostream& os, const Result& result);
+
+// MODIFIES: <os>
+// EFFECTS:  prints the restructuring counters <stats> to <os>
+void printStats(ostream& os, const RestructureStats& stats);
+
+// MODIFIES: <os>
+// EFFECTS:  prints <report> to <os>: bytes by owner, capacity slack, nodes
+//   per level, fill histograms by tenths and the average leaf occupancy
+void printMemory(ostream& os, const MemoryReport& report);
+
+// MODIFIES: <os>
+// EFFECTS:  prints the p50/p90/p99/p99.9/max latency of every timed
+//   command type in <latencies> to <os>
+void printLatencies(ostream& os, const LatencyMap_t& latencies);
+
+
+// application driver; pass --latency to time every tree command,
+// --lazy-delete to turn deletes into tombstones, --buffered to send
+// inserts and deletes through inner node buffers, --multi to map keys to
+// posting lists (which overrides the previous two), --pipelined to read,
+// run and print commands on three threads (one command per line, ending at
+// quit or the end of input)
+int main(int argc, char* argv[]) {
     BTree tree{};
     CommandMap_t cmdMap{                                    // map of command keywords to execution functions
         { kInsertCmd, &performInsert },
         { kDeleteCmd, &performDelete },
+        { kPurgeCmd, &performPurge },
         { kPrintCmd, &performPrint },
-        { kRangeFindCmd, &performRangeFind }
+        { kRangeFindCmd, &performRangeFind },
+        { kReverseFindCmd, &performReverseFind },
+        { kVerifyCmd, &performVerify },
+        { kCompactCmd, &performCompact },
+        { kRepackCmd, &performRepack },
+        { kRebalanceCmd, &performRebalance },
+        { kSplitCmd, &performSplit },
+        { kSearchCmd, &performSearch },
+        { kStatsCmd, &performStats },
+        { kMemoryCmd, &performMemory }
     };
-    auto& err = *outStream;                                 // where to print error messages
+    bool timing = false;                                    // record per-command latencies
+    LatencyMap_t latencies{};
+    bool lazyDelete = false;
+    bool buffered = false;
+    bool multiValue = false;
+    bool pipelined = false;
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i] == kLatencyFlag) {
+            timing = true;
+        }
+        else if (argv[i] == kLazyDeleteFlag) {
+            lazyDelete = true;
+        }
+        else if (argv[i] == kBufferedFlag) {
+            buffered = true;
+        }
+        else if (argv[i] == kMultiValueFlag) {
+            multiValue = true;
+        }
+        else if (argv[i] == kPipelinedFlag) {
+            pipelined = true;
+        }
+    }
+    if (multiValue) {
+        tree.setMultiValue(true);
+        cmdMap.emplace(kPostCmd, &performPost);
+        cmdMap.emplace(kUnpostCmd, &performUnpost);
+        cmdMap.emplace(kPostingsCmd, &performPostings);
+    }
+    else {
+        tree.setLazyDelete(lazyDelete);
+        tree.setBuffered(buffered);
+    }
+
+    if (pipelined) {                                        // this thread executes between the other two
+        std::ios_base::sync_with_stdio(false);              // lets cin read ahead, which batching relies on
+        cin.tie(nullptr);                                   // only the writer may touch cout
+        SpscRing<CommandBatch_t> commands{ kPipelineDepth };
+        SpscRing<ResultBatch_t> results{ kPipelineDepth };
+        thread parser{ parseCommands, std::cref(cmdMap), std::ref(commands) };
+        thread writer{ writeResults, std::ref(results) };
+        bool finished = executeCommands(commands, results, tree, timing);
+        writer.join();
+        parser.join();
+        return finished ? 0 : 1;
+    }
 
     string command{ "" };
     while (true) {
         cin >> command;
         if (command == kQuitCmd) {                          // continue until QUIT command produced
+            if (timing) {
+                printLatencies(cout, latencies);
+            }
             return 0;
         }
+        if (command[0] == '#') {
+            clearLine(cin);
+            continue;
+        }
 
-        try {
-            if (command[0] == '#') {
-                clearLine(cin);
-                continue;
-            }
+        auto funcIter = cmdMap.find(command);
+        ExecFunc_t func = (funcIter == cmdMap.end()) ? nullptr : funcIter->second;
+        Result result{};
+        bool finished = runCommand(command, func, cin, tree, timing, latencies, result);
+        printResult(cout, result);
+        if (!finished) {
+            return 1;
+        }
+    }
 
-            auto funcIter = cmdMap.find(command);
-            if (funcIter == cmdMap.end()) {
-                throw CommandException{};
-            }
-            (*funcIter->second)(cin, tree);
+    return 0;
+}
+
+// run one command, turning any failure into an error message
+bool runCommand(const string& command, ExecFunc_t func, istream& is, BTree& tree,
+                bool timing, LatencyMap_t& latencies, Result& result) {
+    auto fail = [&](const string& message) {
+        result = Result{};
+        result.kind = Output::Text;
+        result.text = "\n" + message + "\n\n";
+    };
+
+    try {
+        if (command == kLatencyCmd) {
+            result.kind = Output::Latencies;
+            result.latencies = latencies;
+            return true;
         }
-        catch (CommandException&) {                                             // unrecognized command, keep going
-            err << "\nUnrecognized command '" << command << "'\n\n";
-            clearLine(cin);
+        if (!func) {
+            throw CommandException{};
         }
-        catch (ReadException&) {                                                // failed integer read, keep going
-            err << "\nUnable to read integer where expected\n\n";
-            clearLine(cin);
+        if (!timing) {
+            result = (*func)(is, tree);
+            return true;
         }
-        catch (bad_alloc&) {                                                    // allocation failure, abort execution
-            err << "\nMemory pool exceeded by over-allocation\n\n";
-            return 1;
+
+        auto start = steady_clock::now();
+        result = (*func)(is, tree);
+        auto elapsed = duration_cast<nanoseconds>(steady_clock::now() - start);
+        latencies[command].record(static_cast<uint64_t>(elapsed.count()));
+        return true;
+    }
+    catch (CommandException&) {                                                 // unrecognized command, keep going
+        fail("Unrecognized command '" + command + "'");
+        clearLine(is);
+    }
+    catch (ReadException&) {                                                    // failed integer read, keep going
+        fail("Unable to read integer where expected");
+        clearLine(is);
+    }
+    catch (bad_alloc&) {                                                        // allocation failure, abort execution
+        fail("Memory pool exceeded by over-allocation");
+        return false;
+    }
+    catch (exception& e) {                                                      // other exception, abort execution
+        fail(string{ "Exception Encountered: " } + e.what());
+        return false;
+    }
+    catch (...) {                                                               // other throwable, abort execution
+        fail("Unidentified object throw and caught");
+        return false;
+    }
+    return true;
+}
+
+// one case per kind of output; nothing is printed for Output::Nothing
+void printResult(ostream& os, const Result& result) {
+    switch (result.kind) {
+        case Output::Nothing:
+            break;
+        case Output::Text:
+            os << result.text;
+            break;
+        case Output::Removed:
+            os << kPrintPrefix << "Removed " << result.removed << " entries\n\n";
+            break;
+        case Output::Entries:
+            printEntries(os, result);
+            break;
+        case Output::Postings:
+            printPostings(os, result);
+            break;
+        case Output::Verified:
+            os << kPrintPrefix << "Verified\n\n";
+            break;
+        case Output::Violated:
+            os << kPrintPrefix << "Invariant violated: " << result.text << "\n\n";
+            break;
+        case Output::Stats:
+            printStats(os, result.stats);
+            break;
+        case Output::Memory:
+            printMemory(os, result.memory);
+            break;
+        case Output::Latencies:
+            printLatencies(os, result.latencies);
+            break;
+    }
+}
+
+// split off the first word of each line; the newline is kept so a misread
+// command can still clear its line. Lines already read ahead into cin go
+// out together, so the batch ends as soon as reading would block
+void parseCommands(const CommandMap_t& cmdMap, SpscRing<CommandBatch_t>& commands) {
+    static const char* const kSpace = " \t\r\v\f";
+
+    CommandBatch_t batch{};
+    string line{ "" };
+    while (std::getline(cin, line)) {
+        size_t begin = line.find_first_not_of(kSpace);
+        if (begin != string::npos && line[begin] != '#') {
+            size_t end = std::min(line.find_first_of(kSpace, begin), line.size());
+            Command command{ line.substr(begin, end - begin), nullptr, line.substr(end) + "\n" };
+            if (command.name == kQuitCmd) {
+                break;
+            }
+            auto funcIter = cmdMap.find(command.name);
+            if (funcIter != cmdMap.end()) {
+                command.func = funcIter->second;
+            }
+            batch.push_back(std::move(command));
         }
-        catch (exception& e) {                                                  // other exception, abort execution
-            err << "\nException Encountered: " << e.what() << "\n\n";
-            return 1;
+
+        if (!batch.empty() && (batch.size() == kBatchCommands || cin.rdbuf()->in_avail() <= 0)) {
+            if (!commands.push(std::move(batch))) {
+                break;
+            }
+            batch.clear();
         }
-        catch (...) {                                                           // other throwable, abort execution
-            err << "\nUnidentified object throw and caught\n\n";
-            return 1;
+    }
+    if (!batch.empty()) {
+        commands.push(std::move(batch));
+    }
+    commands.close();
+}
+
+// only results that print something are handed off, a batch at a time,
+// and the writer formats them
+bool executeCommands(SpscRing<CommandBatch_t>& commands, SpscRing<ResultBatch_t>& results, BTree& tree, bool timing) {
+    LatencyMap_t latencies{};
+    istringstream args{};
+    ResultBatch_t output{};
+    auto handOff = [&]{
+        if (!output.empty()) {
+            results.push(std::move(output));
+            output.clear();
         }
+    };
+
+    bool finished = true;
+    CommandBatch_t batch{};
+    while (finished && commands.pop(batch)) {
+        for (size_t i = 0; finished && i < batch.size(); ++i) {
+            args.clear();
+            args.str(batch[i].args);
+            Result result{};
+            finished = runCommand(batch[i].name, batch[i].func, args, tree, timing, latencies, result);
+            if (result.kind != Output::Nothing) {
+                output.push_back(std::move(result));
+            }
+        }
+        handOff();
+    }
+    if (finished && timing) {
+        output.emplace_back();
+        output.back().kind = Output::Latencies;
+        output.back().latencies = std::move(latencies);
+        handOff();
     }
+    if (!finished) {
+        commands.close();
+    }
+    results.close();
+    return finished;
+}
 
-    return 0;
+// format each batch as it arrives; flushing after each one stands in for
+// cin being tied to cout
+void writeResults(SpscRing<ResultBatch_t>& results) {
+    ResultBatch_t batch{};
+    while (results.pop(batch)) {
+        for (const auto& result : batch) {
+            printResult(cout, result);
+        }
+        cout.flush();
+    }
 }
 
 template <typename Iter>
@@ -137,42 +544,284 @@ void clearLine(istream& is) {
 }
 
 // try to read an integer and perform insert
-void performInsert(istream& is, BTree& tree) {
+Result performInsert(istream& is, BTree& tree) {
     Key key = readKey(is);
     Record record{ key };
     tree.insertEntry(DataEntry{ key, record });
+    return Result{};
 }
 
 // try to read and integer and perform delete
-void performDelete(istream& is, BTree& tree) {
+Result performDelete(istream& is, BTree& tree) {
     Key key = readKey(is);
     Record record{ key };
     tree.deleteEntry(DataEntry{ key, record });
+    return Result{};
 }
 
-// try to read two integers and perform range find, print results of
-// range find to designated output stream
-void performRangeFind(istream& is, BTree& tree) {
+// try to read two integers and delete everything between them, then
+// report how many entries went
+Result performPurge(istream& is, BTree& tree) {
     Key begin = readKey(is);
     Key end = readKey(is);
-    auto results = tree.rangeFind(begin, end);
-    
-    auto& os = *outStream;
-    os << kPrintPrefix << "[ ";
-    for (const auto& val : results) {
-        if (val != results[0]) {
-            os << " | ";
-        }
-        os << val;
+
+    Result result{};
+    result.kind = Output::Removed;
+    result.removed = (end >= begin) ? tree.deleteRange(begin, end) : 0;
+    return result;
+}
+
+// try to read a key and a record and post it
+Result performPost(istream& is, BTree& tree) {
+    Key key = readKey(is);
+    Record record = readKey(is);
+    tree.insertPosting(key, record);
+    return Result{};
+}
+
+// try to read a key and a record and unpost it
+Result performUnpost(istream& is, BTree& tree) {
+    Key key = readKey(is);
+    Record record = readKey(is);
+    tree.deletePosting(key, record);
+    return Result{};
+}
+
+// try to read two integers and collect the postings between them
+Result performPostings(istream& is, BTree& tree) {
+    Key begin = readKey(is);
+    Key end = readKey(is);
+
+    Result result{};
+    result.kind = Output::Postings;
+    result.postings = tree.rangePostings(begin, end);
+    return result;
+}
+
+// try to read two integers and perform range find
+Result performRangeFind(istream& is, BTree& tree) {
+    Key begin = readKey(is);
+    Key end = readKey(is);
+
+    Result result{};
+    result.kind = Output::Entries;
+    result.entries = tree.rangeFind(begin, end);
+    return result;
+}
+
+// try to read two integers and a limit, then collect the tail of the
+// range largest key first
+Result performReverseFind(istream& is, BTree& tree) {
+    Key begin = readKey(is);
+    Key end = readKey(is);
+    Key limit = readKey(is);
+    if (limit < 0) {
+        throw ReadException{};
     }
-    os << " ]\n\n";
+
+    Result result{};
+    result.kind = Output::Entries;
+    result.entries = tree.reverseRangeFind(begin, end, static_cast<size_t>(limit));
+    return result;
 }
 
-// print tree to designated output stream
-void performPrint(istream&, BTree& tree) {
-    auto& out = *outStream;
+// the tree can only be walked here, so it is printed to text right away
+Result performPrint(istream&, BTree& tree) {
+    ostringstream out{};
 
     out << "\n";
     tree.print(out);                    // ends with a newline by LeafNode print
     out << "\n";
+
+    Result result{};
+    result.kind = Output::Text;
+    result.text = out.str();
+    return result;
+}
+
+// verify tree, keep the first violation if there is one
+Result performVerify(istream&, BTree& tree) {
+    Result result{};
+    result.kind = tree.verify(&result.text) ? Output::Verified : Output::Violated;
+    return result;
+}
+
+// compact tree, no output
+Result performCompact(istream&, BTree& tree) {
+    tree.compact();
+    return Result{};
+}
+
+// repack tree, no output
+Result performRepack(istream&, BTree& tree) {
+    tree.repack();
+    return Result{};
+}
+
+// try to read a mode and its minimums, then switch policy
+Result performRebalance(istream& is, BTree& tree) {
+    string mode{ "" };
+    is >> mode;
+
+    TreePolicy policy = tree.getPolicy();
+    if (mode == kStrictMode) {
+        policy.rebalance = Rebalance::Strict;
+    }
+    else if (mode == kFreeAtEmptyMode) {
+        policy.rebalance = Rebalance::FreeAtEmpty;
+    }
+    else if (mode == kThresholdMode) {
+        Key leafMinimum = readKey(is);
+        Key innerMinimum = readKey(is);
+        if (leafMinimum < 1 || static_cast<size_t>(leafMinimum) > kLeafOrder
+            || innerMinimum < 1 || static_cast<size_t>(innerMinimum) > kInnerOrder) {
+            throw ReadException{};
+        }
+        policy.rebalance = Rebalance::Threshold;
+        policy.leafThreshold = static_cast<size_t>(leafMinimum);
+        policy.innerThreshold = static_cast<size_t>(innerMinimum);
+    }
+    else {
+        throw CommandException{};
+    }
+    tree.setPolicy(policy);
+    return Result{};
+}
+
+// try to read a split mode, then switch policy
+Result performSplit(istream& is, BTree& tree) {
+    string mode{ "" };
+    is >> mode;
+
+    TreePolicy policy = tree.getPolicy();
+    if (mode == kEvenSplit) {
+        policy.split = Split::Even;
+    }
+    else if (mode == kEdgeSplit) {
+        policy.split = Split::Edge;
+    }
+    else {
+        throw CommandException{};
+    }
+    tree.setPolicy(policy);
+    return Result{};
+}
+
+// try to read a search mode, then switch policy
+Result performSearch(istream& is, BTree& tree) {
+    string mode{ "" };
+    is >> mode;
+
+    TreePolicy policy = tree.getPolicy();
+    if (mode == kBinarySearch) {
+        policy.search = Search::Binary;
+    }
+    else if (mode == kInterpolationSearch) {
+        policy.search = Search::Interpolation;
+    }
+    else {
+        throw CommandException{};
+    }
+    tree.setPolicy(policy);
+    return Result{};
+}
+
+// copy the counters out so later commands cannot change them
+Result performStats(istream&, BTree& tree) {
+    Result result{};
+    result.kind = Output::Stats;
+    result.stats = tree.getStats();
+    return result;
+}
+
+// the report is taken now and printed whenever the writer gets to it
+Result performMemory(istream&, BTree& tree) {
+    Result result{};
+    result.kind = Output::Memory;
+    result.memory = tree.memoryReport();
+    return result;
+}
+
+// keys only, separated by bars
+void printEntries(ostream& os, const Result& result) {
+    const auto& entries = result.entries;
+
+    OutputBuffer out{ os };
+    out << kPrintPrefix << "[ ";
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (i != 0) {
+            out << " | ";
+        }
+        out << Key(entries[i]);
+    }
+    out << " ]\n\n";
+}
+
+// each key once followed by its records
+void printPostings(ostream& os, const Result& result) {
+    const auto& postings = result.postings;
+
+    OutputBuffer out{ os };
+    out << kPrintPrefix << "[ ";
+    for (size_t i = 0; i < postings.size(); ++i) {
+        if (i == 0 || postings[i].first != postings[i - 1].first) {
+            out << (i == 0 ? "" : " | ") << postings[i].first << ":";
+        }
+        out << " " << postings[i].second;
+    }
+    out << " ]\n\n";
+}
+
+// print every counter on its own line
+void printStats(ostream& out, const RestructureStats& stats) {
+    out << kPrintPrefix << "Splits:  leaf " << stats.leafSplits << "  |  inner " << stats.innerSplits << "\n";
+    out << kPrintPrefix << "Borrows: leaf " << stats.leafBorrows << "  |  inner " << stats.innerBorrows << "\n";
+    out << kPrintPrefix << "Merges:  leaf " << stats.leafMerges << "  |  inner " << stats.innerMerges << "\n";
+    out << kPrintPrefix << "Frees:   leaf " << stats.leafFrees << "  |  inner " << stats.innerFrees << "\n";
+    out << kPrintPrefix << "Buffer flushes: " << stats.bufferFlushes << "\n\n";
+}
+
+// bytes first, then shape, then fill; occupancy in tenths of a percent
+void printMemory(ostream& out, const MemoryReport& report) {
+    out << kPrintPrefix << "Bytes:   total " << report.totalBytes() << "  |  leaf " << report.leafBytes
+        << "  |  inner " << report.innerBytes << "  |  tree " << report.treeBytes << "\n";
+    out << kPrintPrefix << "Slack:   leaf " << report.leafSlackBytes << "  |  inner " << report.innerSlackBytes << "\n";
+    out << kPrintPrefix << "Nodes:   leaf " << report.leafNodes << "  |  inner " << report.innerNodes << "\n";
+    for (size_t level = 0; level < report.nodesPerLevel.size(); ++level) {
+        out << kPrintPrefix << "Level " << level << ": " << report.nodesPerLevel[level] << "\n";
+    }
+
+    out << kPrintPrefix << std::left << setw(12) << "Fill" << std::right;
+    for (size_t bucket = 0; bucket < MemoryReport::kFillBuckets; ++bucket) {
+        out << setw(7) << (std::to_string(bucket * 10) + "%");
+    }
+    out << "\n" << kPrintPrefix << std::left << setw(12) << "  leaf" << std::right;
+    for (auto count : report.leafFill) {
+        out << setw(7) << count;
+    }
+    out << "\n" << kPrintPrefix << std::left << setw(12) << "  inner" << std::right;
+    for (auto count : report.innerFill) {
+        out << setw(7) << count;
+    }
+
+    auto permille = static_cast<size_t>(report.averageLeafOccupancy * 1000 + 0.5);
+    out << "\n" << kPrintPrefix << "Average leaf occupancy: " << permille / 10 << '.' << permille % 10 << "%\n\n";
+}
+
+// one row per command type in a fixed order, all values in nanoseconds
+void printLatencies(ostream& out, const LatencyMap_t& latencies) {
+    out << "\n" << kPrintPrefix << std::left << setw(10) << "ns" << std::right
+        << setw(12) << "count" << setw(12) << "p50" << setw(12) << "p90"
+        << setw(12) << "p99" << setw(12) << "p99.9" << setw(12) << "max" << "\n";
+    for (const auto& name : { kInsertCmd, kDeleteCmd, kRangeFindCmd, kPrintCmd }) {
+        auto iter = latencies.find(name);
+        LatencyHistogram empty{};
+        const auto& hist = (iter == latencies.end()) ? empty : iter->second;
+
+        out << kPrintPrefix << std::left << setw(10) << name << std::right
+            << setw(12) << hist.count() << setw(12) << hist.percentile(50)
+            << setw(12) << hist.percentile(90) << setw(12) << hist.percentile(99)
+            << setw(12) << hist.percentile(99.9) << setw(12) << hist.max() << "\n";
+    }
+    out << "\n";
 }